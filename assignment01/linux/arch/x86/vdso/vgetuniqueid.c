@@ -0,0 +1,38 @@
+/*
+ * Subject to the GNU Public License, v.2
+ *
+ * Fast user context implementation of get_unique_id(). IDs are served
+ * from a per-thread lease in userspace, the kernel is only entered to
+ * reserve a new range once the lease is exhausted.
+ */
+
+#include <linux/kernel.h>
+#include <linux/unique_id.h>
+#include <asm/unistd.h>
+
+notrace static long vdso_fallback_get_unique_ids(int *first, unsigned long n)
+{
+	long ret;
+
+	asm volatile("syscall" : "=a" (ret) :
+		     "0" (__NR_get_unique_ids), "D" (first), "S" (n) :
+		     "rcx", "r11", "memory");
+	return ret;
+}
+
+notrace long
+__vdso_get_unique_id(int *uuid, struct unique_id_lease *lease)
+{
+	long ret;
+
+	if (unlikely(lease->next == lease->end)) {
+		ret = vdso_fallback_get_unique_ids(&lease->next,
+						   UNIQUE_ID_VDSO_LEASE);
+		if (ret)
+			return ret;
+		lease->end = lease->next + UNIQUE_ID_VDSO_LEASE;
+	}
+
+	*uuid = lease->next++;
+	return 0;
+}
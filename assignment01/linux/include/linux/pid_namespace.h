@@ -19,6 +19,7 @@ struct pidmap {
 #define PIDMAP_ENTRIES		((PID_MAX_LIMIT+BITS_PER_PAGE-1)/BITS_PER_PAGE)
 
 struct bsd_acct_struct;
+struct unique_id_counter;
 
 struct pid_namespace {
 	struct kref kref;
@@ -44,6 +45,7 @@ struct pid_namespace {
 	int hide_pid;
 	int reboot;	/* group exit code if this pidns was rebooted */
 	unsigned int proc_inum;
+	struct unique_id_counter *unique_id;	/* NULL: global counter */
 };
 
 extern struct pid_namespace init_pid_ns;
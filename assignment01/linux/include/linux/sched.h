@@ -133,6 +133,7 @@ struct fs_struct;
 struct perf_event_context;
 struct blk_plug;
 struct filename;
+struct unique_id_lease;
 
 #define VMACACHE_BITS 2
 #define VMACACHE_SIZE (1U << VMACACHE_BITS)
@@ -1346,6 +1347,7 @@ struct task_struct {
 	 */
 	struct list_head children;	/* list of my children */
 	struct list_head sibling;	/* linkage in my parent's children list */
+	unsigned int nr_children;	/* length of children, tasklist_lock */
 	struct task_struct *group_leader;	/* threadgroup leader */
 
 	/*
@@ -1364,6 +1366,7 @@ struct task_struct {
 	struct completion *vfork_done;		/* for vfork() */
 	int __user *set_child_tid;		/* CLONE_CHILD_SETTID */
 	int __user *clear_child_tid;		/* CLONE_CHILD_CLEARTID */
+	struct unique_id_lease __user *unique_id_lease;	/* vDSO ID lease */
 
 	cputime_t utime, stime, utimescaled, stimescaled;
 	cputime_t gtime;
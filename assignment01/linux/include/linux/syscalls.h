@@ -65,6 +65,8 @@ struct old_linux_dirent;
 struct perf_event_attr;
 struct file_handle;
 struct sigaltstack;
+struct unique_id_lease;
+struct descendant_pid;
 union bpf_attr;
 
 #include <linux/types.h>
@@ -880,6 +882,15 @@ asmlinkage long sys_bpf(int cmd, union bpf_attr *attr, unsigned int size);
 
 // Own Syscalls
 asmlinkage long sys_get_unique_id(int *uuid);
+asmlinkage long sys_get_unique_id64(u64 *uuid);
+asmlinkage long sys_get_unique_ids(int *first, size_t n);
+asmlinkage long sys_set_unique_id_lease(struct unique_id_lease __user *lease);
+asmlinkage long sys_set_unique_id_scope(int scope);
 asmlinkage long sys_get_child_pids(pid_t* list, size_t limit, size_t* num_children);
+asmlinkage long sys_get_child_pids_page(pid_t *list, size_t limit, pid_t cursor,
+					unsigned int *num_children);
+asmlinkage long sys_get_descendant_pids(pid_t root, struct descendant_pid *list,
+					size_t limit, unsigned int max_depth,
+					unsigned int *num_descendants);
 
 #endif
@@ -0,0 +1,14 @@
+#ifndef _LINUX_UNIQUE_ID_H
+#define _LINUX_UNIQUE_ID_H
+
+#include <uapi/linux/unique_id.h>
+
+struct unique_id_counter;
+
+/* Empty the lease a freshly forked child inherited from its parent */
+extern void unique_id_lease_fork(void);
+
+/* Release the private counter of a dying PID namespace */
+extern void unique_id_ns_free(struct unique_id_counter *c);
+
+#endif /* _LINUX_UNIQUE_ID_H */
@@ -0,0 +1,95 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM child_pids
+
+#if !defined(_TRACE_CHILD_PIDS_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_CHILD_PIDS_H
+
+#include <linux/tracepoint.h>
+
+#ifndef _TRACE_CHILD_PIDS_CALLS
+#define _TRACE_CHILD_PIDS_CALLS
+/* Syscall a child_pids event was fired from */
+enum child_pids_call {
+	CHILD_PIDS_CALL_LIST,		/* get_child_pids */
+	CHILD_PIDS_CALL_PAGE,		/* get_child_pids_page */
+	CHILD_PIDS_CALL_DESCENDANTS,	/* get_descendant_pids */
+};
+#endif
+
+#define show_child_pids_call(call)					\
+	__print_symbolic(call,						\
+		{ CHILD_PIDS_CALL_LIST,		"get_child_pids" },	\
+		{ CHILD_PIDS_CALL_PAGE,		"get_child_pids_page" },\
+		{ CHILD_PIDS_CALL_DESCENDANTS,	"get_descendant_pids" })
+
+TRACE_EVENT(child_pids_enter,
+
+	TP_PROTO(int call, size_t limit),
+
+	TP_ARGS(call, limit),
+
+	TP_STRUCT__entry(
+		__field(	int,		call	)
+		__field(	size_t,		limit	)
+	),
+
+	TP_fast_assign(
+		__entry->call	= call;
+		__entry->limit	= limit;
+	),
+
+	TP_printk("call=%s limit=%zu", show_child_pids_call(__entry->call),
+		  __entry->limit)
+);
+
+/*
+ * scanned is the number of tasks looked at (children for get_child_pids,
+ * PIDs of the namespace for the others), copied the PIDs returned.
+ */
+TRACE_EVENT(child_pids_exit,
+
+	TP_PROTO(int call, size_t scanned, size_t copied, long ret),
+
+	TP_ARGS(call, scanned, copied, ret),
+
+	TP_STRUCT__entry(
+		__field(	int,		call	)
+		__field(	size_t,		scanned	)
+		__field(	size_t,		copied	)
+		__field(	long,		ret	)
+	),
+
+	TP_fast_assign(
+		__entry->call		= call;
+		__entry->scanned	= scanned;
+		__entry->copied		= copied;
+		__entry->ret		= ret;
+	),
+
+	TP_printk("call=%s scanned=%zu copied=%zu ret=%ld",
+		  show_child_pids_call(__entry->call), __entry->scanned,
+		  __entry->copied, __entry->ret)
+);
+
+/* One read-side hold of tasklist_lock by get_child_pids */
+TRACE_EVENT(child_pids_lock,
+
+	TP_PROTO(u64 hold_ns),
+
+	TP_ARGS(hold_ns),
+
+	TP_STRUCT__entry(
+		__field(	u64,	hold_ns	)
+	),
+
+	TP_fast_assign(
+		__entry->hold_ns = hold_ns;
+	),
+
+	TP_printk("hold_ns=%llu", __entry->hold_ns)
+);
+
+#endif /* _TRACE_CHILD_PIDS_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
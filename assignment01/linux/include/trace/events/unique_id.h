@@ -0,0 +1,74 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM unique_id
+
+#if !defined(_TRACE_UNIQUE_ID_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_UNIQUE_ID_H
+
+#include <linux/tracepoint.h>
+
+#ifndef _TRACE_UNIQUE_ID_CALLS
+#define _TRACE_UNIQUE_ID_CALLS
+/* Syscall a unique_id event was fired from */
+enum unique_id_call {
+	UNIQUE_ID_CALL_ID,		/* get_unique_id */
+	UNIQUE_ID_CALL_ID64,		/* get_unique_id64 */
+	UNIQUE_ID_CALL_IDS,		/* get_unique_ids */
+};
+#endif
+
+#define show_unique_id_call(call)					\
+	__print_symbolic(call,						\
+		{ UNIQUE_ID_CALL_ID,	"get_unique_id" },		\
+		{ UNIQUE_ID_CALL_ID64,	"get_unique_id64" },		\
+		{ UNIQUE_ID_CALL_IDS,	"get_unique_ids" })
+
+TRACE_EVENT(unique_id_enter,
+
+	TP_PROTO(int call),
+
+	TP_ARGS(call),
+
+	TP_STRUCT__entry(
+		__field(	int,	call	)
+	),
+
+	TP_fast_assign(
+		__entry->call = call;
+	),
+
+	TP_printk("call=%s", show_unique_id_call(__entry->call))
+);
+
+/*
+ * first and count describe the IDs issued to the caller, first is
+ * negative (and count meaningless) when the allocation failed.
+ */
+TRACE_EVENT(unique_id_exit,
+
+	TP_PROTO(int call, s64 first, u64 count, long ret),
+
+	TP_ARGS(call, first, count, ret),
+
+	TP_STRUCT__entry(
+		__field(	int,	call	)
+		__field(	s64,	first	)
+		__field(	u64,	count	)
+		__field(	long,	ret	)
+	),
+
+	TP_fast_assign(
+		__entry->call	= call;
+		__entry->first	= first;
+		__entry->count	= count;
+		__entry->ret	= ret;
+	),
+
+	TP_printk("call=%s first=%lld count=%llu ret=%ld",
+		  show_unique_id_call(__entry->call), __entry->first,
+		  __entry->count, __entry->ret)
+);
+
+#endif /* _TRACE_UNIQUE_ID_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,13 @@
+#ifndef _UAPI_LINUX_CHILD_PIDS_H
+#define _UAPI_LINUX_CHILD_PIDS_H
+
+#include <linux/types.h>
+
+/* One entry of the subtree returned by get_descendant_pids() */
+struct descendant_pid {
+	__kernel_pid_t pid;
+	__kernel_pid_t ppid;	/* parent process */
+	__u32 depth;		/* 1 for children of the root */
+};
+
+#endif /* _UAPI_LINUX_CHILD_PIDS_H */
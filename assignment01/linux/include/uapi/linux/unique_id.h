@@ -0,0 +1,24 @@
+#ifndef _UAPI_LINUX_UNIQUE_ID_H
+#define _UAPI_LINUX_UNIQUE_ID_H
+
+#include <linux/types.h>
+
+/*
+ * Range of IDs leased to one thread and consumed in userspace by
+ * __vdso_get_unique_id. The IDs next .. end - 1 belong to the owner.
+ * Register it with set_unique_id_lease() so that the kernel empties it
+ * in the child after a fork.
+ */
+struct unique_id_lease {
+	__s32 next;
+	__s32 end;
+};
+
+/* Number of IDs the vDSO reserves whenever a lease runs dry */
+#define UNIQUE_ID_VDSO_LEASE	64
+
+/* Scopes for set_unique_id_scope() */
+#define UNIQUE_ID_SCOPE_GLOBAL	0	/* one counter for the whole system */
+#define UNIQUE_ID_SCOPE_PID_NS	1	/* counter private to the PID namespace */
+
+#endif /* _UAPI_LINUX_UNIQUE_ID_H */
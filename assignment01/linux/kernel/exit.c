@@ -70,6 +70,9 @@ static void __unhash_process(struct task_struct *p, bool group_dead)
 		detach_pid(p, PIDTYPE_SID);
 
 		list_del_rcu(&p->tasks);
+		/* Already unlinked if forget_original_parent() found it dead */
+		if (!list_empty(&p->sibling))
+			p->real_parent->nr_children--;
 		list_del_init(&p->sibling);
 		__this_cpu_dec(process_counts);
 	}
@@ -530,6 +533,8 @@ static void reparent_leader(struct task_struct *father, struct task_struct *p,
 				struct list_head *dead)
 {
 	list_move_tail(&p->sibling, &p->real_parent->children);
+	father->nr_children--;
+	p->real_parent->nr_children++;
 
 	if (p->exit_state == EXIT_DEAD)
 		return;
@@ -549,6 +554,7 @@ static void reparent_leader(struct task_struct *father, struct task_struct *p,
 		if (do_notify_parent(p, p->exit_signal)) {
 			p->exit_state = EXIT_DEAD;
 			list_move_tail(&p->sibling, dead);
+			p->real_parent->nr_children--;
 		}
 	}
 
@@ -586,6 +592,7 @@ static void forget_original_parent(struct task_struct *father)
 	write_unlock_irq(&tasklist_lock);
 
 	BUG_ON(!list_empty(&father->children));
+	WARN_ON_ONCE(father->nr_children);
 
 	list_for_each_entry_safe(p, n, &dead_children, sibling) {
 		list_del_init(&p->sibling);
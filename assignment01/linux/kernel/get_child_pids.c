@@ -6,78 +6,397 @@
 #include<linux/spinlock.h>
 #include<linux/uaccess.h>
 #include<linux/list.h>
+#include<linux/pid.h>
+#include<linux/pid_namespace.h>
+#include<linux/rcupdate.h>
+#include<uapi/linux/child_pids.h>
 
-asmlinkage long sys_get_child_pids(pid_t *list, size_t limit,
-	size_t *num_children)
-{
-	/* return value of the function */
-	long res;
+#define CREATE_TRACE_POINTS
+#include<trace/events/child_pids.h>
 
-	res = 0;
+/* Number of PIDs staged on the kernel stack between two copies to user */
+#define GCP_CHUNK	64
 
-	/* Counter for children tasks */
-	size_t children_count;
+/* Entries staged by get_descendant_pids */
+#define GDP_CHUNK	32
 
-	children_count = 0;
+/* PIDs scanned per RCU section by get_child_pids_page/get_descendant_pids */
+#define GDP_SCAN	1024
 
-	/* First check on memory validity */
-	if (list == NULL && limit != 0) {
-		/* printk(KERN_ERR "List is NULL whereas limit is nonzero!\n"); */
-		return -EFAULT;
-	}
+/* What a call looked at and returned, reported by trace_child_pids_exit */
+struct gcp_stats {
+	size_t scanned;
+	size_t copied;
+};
 
-	struct task_struct *_current;
-	
-	/* We need to lock tasklist_lock because other processes might work on that list */
-	
+/* Read-lock tasklist_lock, timing the hold if someone traces it */
+static inline u64 gcp_lock(void)
+{
 	read_lock(&tasklist_lock);
-	
-	int array[limit];
-	int i;
-	
-	i = 0;
 
-	/* Iterate on children */
+	return trace_child_pids_lock_enabled() ? local_clock() : 0;
+}
+
+static inline void gcp_unlock(u64 locked_at)
+{
+	read_unlock(&tasklist_lock);
+
+	if (locked_at)
+		trace_child_pids_lock(local_clock() - locked_at);
+}
+
+/*
+ * The children list is only stable under tasklist_lock (reaping unlinks
+ * a child with list_del_init, which is not safe for lockless readers).
+ * We therefore stage PIDs in a small chunk under the read lock and drop
+ * the lock whenever the chunk has to be copied out. The child we stopped
+ * at is pinned so the walk can resume from it; if it was reaped in the
+ * meantime the walk restarts and skips as many children as were already
+ * copied. Like the count, the list is then only a best-effort view of
+ * children that exit during the call.
+ */
+static long do_get_child_pids(pid_t *list, size_t limit,
+	size_t *num_children, struct gcp_stats *stats)
+{
+	/* return value of the function */
+	long res = 0;
+
+	pid_t chunk[GCP_CHUNK];
 	struct task_struct *child;
+	u64 locked_at;
 
-	list_for_each_entry(child, &current->children, sibling) {
+	/* Counter for children tasks, PIDs already copied and staged */
+	size_t children_count = 0;
+	size_t copied = 0;
+	unsigned int staged = 0;
 
-		/* Extract pid of child */
-		pid_t child_id;
+	/* First check on memory validity */
+	if (list == NULL && limit != 0)
+		return -EFAULT;
+
+	/* Only the number of children is wanted, no need to walk the list */
+	if (limit == 0) {
+		children_count = ACCESS_ONCE(current->nr_children);
+		if (put_user(children_count, num_children))
+			return -EFAULT;
+		return children_count ? -ENOBUFS : 0;
+	}
+
+	locked_at = gcp_lock();
+
+restart:
+	children_count = 0;
+	child = list_entry(&current->children, struct task_struct, sibling);
 
-		child_id = child->pid;
+	list_for_each_entry_continue(child, &current->children, sibling) {
 
 		/* Increment number of children */
 		children_count++;
+		stats->scanned++;
 
-		if (children_count <= limit) {
-			/* Store children pid in the list */
-			array[i] = child_id;
-			i++;
+		/* Already copied in a previous chunk, or beyond limit */
+		if (children_count <= copied || children_count > limit)
+			continue;
+
+		chunk[staged++] = task_pid_vnr(child);
+		if (staged < GCP_CHUNK)
+			continue;
+
+		/* Chunk is full: copy it out without holding the lock */
+		get_task_struct(child);
+		gcp_unlock(locked_at);
+
+		if (copy_to_user(list + copied, chunk, sizeof(chunk))) {
+			put_task_struct(child);
+			return -EFAULT;
 		}
-	}
-	
-	read_unlock(&tasklist_lock);
-	
-	int j;
-	for (j = 0; j < limit; j++) {
-		put_user(array[j], list);
-		list++;
+		copied += staged;
+		stats->copied = copied;
+		staged = 0;
+
+		locked_at = gcp_lock();
+		if (list_empty(&child->sibling)) {
+			/* Reaped while unlocked, we lost our position */
+			put_task_struct(child);
+			goto restart;
+		}
+		put_task_struct(child);
 	}
 
+	gcp_unlock(locked_at);
+
+	/* Copy what is left in the last chunk */
+	if (staged && copy_to_user(list + copied, chunk,
+				   staged * sizeof(pid_t)))
+		return -EFAULT;
+	stats->copied = copied + staged;
+
 	if (children_count > limit) {
-		/* Need to return -ENOBUFFS; */
-		/* printk(KERN_ERR "List is too big to fit !\n"); */
+		/* List is too big to fit */
 		res = -ENOBUFS;
 	}
 
-	/* Lock for the writing in num_children */
+	if (put_user(children_count, num_children))
+		return -EFAULT;
+
+	return res;
+}
+
+asmlinkage long sys_get_child_pids(pid_t *list, size_t limit,
+	size_t *num_children)
+{
+	struct gcp_stats stats = { 0, 0 };
+	long res;
+
+	trace_child_pids_enter(CHILD_PIDS_CALL_LIST, limit);
+	res = do_get_child_pids(list, limit, num_children, &stats);
+	trace_child_pids_exit(CHILD_PIDS_CALL_LIST, stats.scanned,
+			      stats.copied, res);
+
+	return res;
+}
+
+/*
+ * First child of current whose PID (in our namespace) is at least *nr.
+ * Walks the PID map in order under RCU, the way /proc readdir does, so no
+ * tasklist_lock is needed, but only for *budget more PIDs. Returns the
+ * child with *nr just past it, or 0 with *nr where to resume once the
+ * budget is spent, or 0 with *nr = 0 at the end of the map.
+ */
+static pid_t next_child_pid(pid_t *nr, struct pid_namespace *ns,
+	unsigned int *budget, size_t *scanned)
+{
+	struct task_struct *task;
+	struct pid *pid;
+	pid_t found;
+
+	while (*budget) {
+		pid = find_ge_pid(*nr, ns);
+		if (!pid) {
+			*nr = 0;
+			return 0;
+		}
+		found = pid_nr_ns(pid, ns);
+		*nr = found + 1;
+		(*budget)--;
+		(*scanned)++;
+
+		/* Threads of a child share its real_parent but aren't children */
+		task = pid_task(pid, PIDTYPE_PID);
+		if (task && thread_group_leader(task) &&
+		    rcu_dereference(task->real_parent) == current)
+			return found;
+	}
+
+	return 0;
+}
+
+/*
+ * Paginated variant of get_child_pids: stores in list the PIDs of at most
+ * limit children whose PID is greater than cursor, in increasing order,
+ * and their number in num_children. Passing the last PID returned as the
+ * next cursor streams the whole set; a short page means the end was
+ * reached. Children forked or reaped in the meantime may or may not show
+ * up, but no PID is ever returned twice.
+ */
+static long do_get_child_pids_page(pid_t *list, size_t limit,
+	pid_t cursor, unsigned int *num_children, struct gcp_stats *stats)
+{
+	struct pid_namespace *ns = task_active_pid_ns(current);
+	pid_t chunk[GCP_CHUNK];
+	size_t copied = 0;
+	unsigned int staged, budget;
+	pid_t nr, child;
+
+	if (list == NULL && limit != 0)
+		return -EFAULT;
+	if (cursor < 0)
+		return -EINVAL;
+
+	/*
+	 * No PID lies past the map, so such a cursor gets an empty page; it
+	 * also keeps cursor + 1 from overflowing (undefined for a pid_t).
+	 */
+	nr = cursor < PID_MAX_LIMIT ? cursor + 1 : 0;
+	while (nr && copied < limit) {
+		staged = 0;
+		budget = GDP_SCAN;
+
+		/* Bounded, a high cursor may leave most of the map to scan */
+		rcu_read_lock();
+		while (staged < GCP_CHUNK && copied + staged < limit) {
+			child = next_child_pid(&nr, ns, &budget,
+					       &stats->scanned);
+			if (!child)
+				break;
+			chunk[staged++] = child;
+		}
+		rcu_read_unlock();
+
+		if (copy_to_user(list + copied, chunk, staged * sizeof(pid_t)))
+			return -EFAULT;
+		copied += staged;
+		stats->copied = copied;
+
+		/* Reached the end of the PID map */
+		if (!nr)
+			break;
+
+		cond_resched();
+	}
+
+	if (put_user(copied, num_children))
+		return -EFAULT;
+
+	return 0;
+}
+
+/*
+ * The counts of get_child_pids_page and get_descendant_pids are unsigned
+ * ints, the same 4 bytes for i386, x32 and x86_64 callers; a size_t would
+ * be written as 8 into a 4-byte slot by a 64-bit kernel.
+ */
+asmlinkage long sys_get_child_pids_page(pid_t *list, size_t limit,
+	pid_t cursor, unsigned int *num_children)
+{
+	struct gcp_stats stats = { 0, 0 };
+	long res;
+
+	trace_child_pids_enter(CHILD_PIDS_CALL_PAGE, limit);
+	res = do_get_child_pids_page(list, limit, cursor, num_children,
+				     &stats);
+	trace_child_pids_exit(CHILD_PIDS_CALL_PAGE, stats.scanned,
+			      stats.copied, res);
+
+	return res;
+}
+
+/*
+ * Depth of task below root (a thread group leader), or 0 if task is not
+ * one of its descendants within max_depth generations. Must be called
+ * under RCU, real_parent is RCU protected.
+ */
+static unsigned int descendant_depth(struct task_struct *task,
+	struct task_struct *root, unsigned int max_depth)
+{
+	unsigned int depth;
+
+	for (depth = 1; depth <= max_depth; depth++) {
+		task = rcu_dereference(task->real_parent)->group_leader;
+		if (task == root)
+			return depth;
+		if (task == &init_task)
+			break;
+	}
+
+	return 0;
+}
 
-	if (put_user(children_count, num_children) == -EFAULT) {
-		/* printk(KERN_ERR "Cannot write number of children\n"); */
+/*
+ * Snapshot of the subtree below root (0 for the caller): stores at most
+ * limit (pid, ppid, depth) entries in list, in increasing PID order, and
+ * the number of descendants in num_descendants. Only max_depth levels
+ * are visited. Like get_child_pids, returns -ENOBUFS when the subtree
+ * does not fit in limit entries.
+ *
+ * Rather than recursing through the children lists, which would need
+ * tasklist_lock, every process in our PID namespace is visited once under
+ * RCU and climbs its real_parent chain for at most max_depth steps.
+ */
+static long do_get_descendant_pids(pid_t root_pid,
+	struct descendant_pid *list, size_t limit, unsigned int max_depth,
+	unsigned int *num_descendants, struct gcp_stats *stats)
+{
+	struct pid_namespace *ns = task_active_pid_ns(current);
+	struct descendant_pid chunk[GDP_CHUNK];
+	struct task_struct *root, *task;
+	size_t descendant_count = 0;
+	size_t copied = 0;
+	unsigned int staged, scanned, depth;
+	struct pid *pid;
+	pid_t nr = 1;
 
+	if (list == NULL && limit != 0)
 		return -EFAULT;
+	if (max_depth == 0)
+		return -EINVAL;
+
+	rcu_read_lock();
+	root = root_pid ? find_task_by_vpid(root_pid) : current;
+	if (root)
+		root = root->group_leader;
+	rcu_read_unlock();
+	if (!root)
+		return -ESRCH;
+
+	/* Keeps root valid (and its address unique) while we are unlocked */
+	get_task_struct(root);
+
+	while (nr) {
+		staged = 0;
+
+		rcu_read_lock();
+		for (scanned = 0; scanned < GDP_SCAN && staged < GDP_CHUNK;
+		     scanned++, nr++) {
+			pid = find_ge_pid(nr, ns);
+			if (!pid) {
+				nr = 0;
+				break;
+			}
+			nr = pid_nr_ns(pid, ns);
+			stats->scanned++;
+
+			task = pid_task(pid, PIDTYPE_PID);
+			if (!task || !thread_group_leader(task) || task == root)
+				continue;
+
+			depth = descendant_depth(task, root, max_depth);
+			if (!depth)
+				continue;
+
+			descendant_count++;
+			if (copied + staged >= limit)
+				continue;
+
+			chunk[staged].pid = nr;
+			chunk[staged].ppid = task_tgid_nr_ns(
+				rcu_dereference(task->real_parent), ns);
+			chunk[staged].depth = depth;
+			staged++;
+		}
+		rcu_read_unlock();
+
+		if (copy_to_user(list + copied, chunk,
+				 staged * sizeof(*chunk))) {
+			put_task_struct(root);
+			return -EFAULT;
+		}
+		copied += staged;
+		stats->copied = copied;
+
+		cond_resched();
 	}
 
+	put_task_struct(root);
+
+	if (put_user(descendant_count, num_descendants))
+		return -EFAULT;
+
+	return descendant_count > limit ? -ENOBUFS : 0;
+}
+
+asmlinkage long sys_get_descendant_pids(pid_t root_pid,
+	struct descendant_pid *list, size_t limit, unsigned int max_depth,
+	unsigned int *num_descendants)
+{
+	struct gcp_stats stats = { 0, 0 };
+	long res;
+
+	trace_child_pids_enter(CHILD_PIDS_CALL_DESCENDANTS, limit);
+	res = do_get_descendant_pids(root_pid, list, limit, max_depth,
+				     num_descendants, &stats);
+	trace_child_pids_exit(CHILD_PIDS_CALL_DESCENDANTS, stats.scanned,
+			      stats.copied, res);
+
 	return res;
 }
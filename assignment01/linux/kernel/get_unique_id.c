@@ -2,22 +2,282 @@
 #include<linux/uaccess.h>
 #include<linux/module.h>
 #include<linux/init.h>
-#include<linux/spinlock.h>
+#include<linux/percpu.h>
+#include<linux/atomic.h>
+#include<linux/errno.h>
+#include<linux/sched.h>
+#include<linux/slab.h>
+#include<linux/capability.h>
+#include<linux/pid_namespace.h>
+#include<linux/rcupdate.h>
+#include<linux/unique_id.h>
 
-spinlock_t uuid_lock;
-DEFINE_SPINLOCK(uuid_lock);
-long id;
+#define CREATE_TRACE_POINTS
+#include<trace/events/unique_id.h>
 
+/*
+ * IDs are reserved from the global 64-bit counter in leases of
+ * sysctl_unique_id_lease consecutive values. Every CPU serves calls
+ * from its own lease, so the shared counter is only touched once per
+ * lease instead of once per call. Leases never overlap, hence IDs stay
+ * unique across CPUs (but are no longer handed out in order).
+ *
+ * The counter never wraps: once it runs past S64_MAX every caller gets
+ * -EOVERFLOW, and the 32-bit entry points fail the same way as soon as
+ * an ID no longer fits in an int.
+ *
+ * A PID namespace can opt in to a counter (and leases) of its own with
+ * set_unique_id_scope(), so containers don't contend on the global one.
+ * Its IDs are then only unique within that namespace.
+ */
+struct uuid_lease {
+	s64 next;	/* next ID to hand out */
+	s64 end;	/* first ID past the lease */
+};
+
+struct unique_id_counter {
+	atomic64_t id;
+	struct uuid_lease __percpu *leases;
+} ____cacheline_aligned_in_smp;
+
+static DEFINE_PER_CPU(struct uuid_lease, uuid_leases);
+
+static struct unique_id_counter uuid_global = {
+	.id	= ATOMIC64_INIT(0),
+	.leases	= &uuid_leases,
+};
+
+/* Lease size, tunable through /proc/sys/kernel/unique_id_lease */
+int sysctl_unique_id_lease = 64;
+int unique_id_lease_min = 1;
+int unique_id_lease_max = 1 << 16;
+
+/* Largest range sys_get_unique_ids hands out in one call */
+#define UUID_BATCH_MAX	(1 << 16)
+
+/* Counter of the caller's PID namespace, or the global one */
+static struct unique_id_counter *uuid_counter(void)
+{
+	struct unique_id_counter *c;
+
+	c = ACCESS_ONCE(task_active_pid_ns(current)->unique_id);
+
+	return c ? c : &uuid_global;
+}
+
+/*
+ * Reserve n consecutive IDs from counter c, returns the first one or
+ * -EOVERFLOW once the ID space is exhausted. A failed reservation leaves
+ * the counter negative, which takes another 2^63 increments to wrap, so
+ * no ID is ever handed out twice.
+ */
+static s64 uuid_reserve(struct unique_id_counter *c, s64 n)
+{
+	s64 end = atomic64_add_return(n, &c->id);
+
+	if (end < 0)
+		return -EOVERFLOW;
+
+	return end - n;
+}
+
+/*
+ * Take the next ID from this CPU's lease. Preemption stays disabled from
+ * the counter lookup on, which sys_set_unique_id_scope() relies on.
+ */
+static s64 uuid_next(void)
+{
+	struct unique_id_counter *c;
+	struct uuid_lease *lease;
+	s64 _id;
+
+	preempt_disable();
+	c = uuid_counter();
+	lease = this_cpu_ptr(c->leases);
+	if (lease->next == lease->end) {
+		s64 size = ACCESS_ONCE(sysctl_unique_id_lease);
+
+		_id = uuid_reserve(c, size);
+		if (_id < 0) {
+			preempt_enable();
+			return _id;
+		}
+		lease->next = _id;
+		lease->end = _id + size;
+	}
+	_id = lease->next++;
+	preempt_enable();
+
+	return _id;
+}
+
+asmlinkage long sys_get_unique_id64(u64 *uuid)
+{
+	s64 _id;
+	long ret;
+
+	trace_unique_id_enter(UNIQUE_ID_CALL_ID64);
+
+	/* Try to write the ID */
+	_id = uuid_next();
+	ret = _id < 0 ? _id : put_user((u64)_id, uuid);
+
+	trace_unique_id_exit(UNIQUE_ID_CALL_ID64, _id, 1, ret);
+
+	return ret;
+}
+
+/* Compat entry point, fails instead of wrapping past INT_MAX */
 asmlinkage long sys_get_unique_id(int *uuid)
 {
+	s64 _id;
+	long ret;
+
+	trace_unique_id_enter(UNIQUE_ID_CALL_ID);
 
 	/* Try to write the ID */
-	long _id;
-	
-	spin_lock(&uuid_lock);
-	_id = id;
-	id++;
-	spin_unlock(&uuid_lock);
-
-	return put_user(_id, uuid);
+	_id = uuid_next();
+	if (_id < 0)
+		ret = _id;
+	else if (_id > INT_MAX)
+		ret = -EOVERFLOW;
+	else
+		ret = put_user((int)_id, uuid);
+
+	trace_unique_id_exit(UNIQUE_ID_CALL_ID, _id, 1, ret);
+
+	return ret;
+}
+
+/*
+ * Reserve n consecutive IDs with a single atomic operation. The first one
+ * is written to *first, the caller owns first .. first + n - 1.
+ */
+asmlinkage long sys_get_unique_ids(int *first, size_t n)
+{
+	s64 _id = -EINVAL;
+	long ret;
+
+	trace_unique_id_enter(UNIQUE_ID_CALL_IDS);
+
+	if (n == 0 || n > UUID_BATCH_MAX) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	preempt_disable();
+	_id = uuid_reserve(uuid_counter(), n);
+	preempt_enable();
+	if (_id < 0)
+		ret = _id;
+	else if (_id + n - 1 > INT_MAX)
+		ret = -EOVERFLOW;
+	else
+		ret = put_user((int)_id, first);
+
+out:
+	trace_unique_id_exit(UNIQUE_ID_CALL_IDS, _id, n, ret);
+
+	return ret;
+}
+
+/*
+ * Register the userspace lease that __vdso_get_unique_id serves this
+ * thread from, NULL unregisters it. The kernel never fills the lease
+ * itself, it only empties it in the child after a fork so that parent
+ * and child cannot hand out the same IDs.
+ */
+asmlinkage long sys_set_unique_id_lease(struct unique_id_lease __user *lease)
+{
+	if (lease && !access_ok(VERIFY_WRITE, lease, sizeof(*lease)))
+		return -EFAULT;
+
+	current->unique_id_lease = lease;
+
+	return 0;
+}
+
+void unique_id_lease_fork(void)
+{
+	struct unique_id_lease __user *lease = current->unique_id_lease;
+
+	/* An empty lease makes the next vDSO call reserve a fresh one */
+	if (put_user(0, &lease->next) || put_user(0, &lease->end))
+		current->unique_id_lease = NULL;
+}
+
+/* Moves counter c up to the global one, if it is behind */
+static void uuid_catch_up(struct unique_id_counter *c)
+{
+	s64 global = atomic64_read(&uuid_global.id);
+	s64 old;
+
+	while ((old = atomic64_read(&c->id)) < global) {
+		if (atomic64_cmpxchg(&c->id, old, global) == old)
+			break;
+	}
+}
+
+/*
+ * Give the caller's PID namespace its own counter (UNIQUE_ID_SCOPE_PID_NS).
+ * There is no way back to the global counter, that would hand out IDs
+ * again. Child namespaces keep using the global counter unless they opt
+ * in as well.
+ *
+ * The new counter starts where the global one is, past every ID the
+ * namespace drew before, leases included. Draws racing with the switch
+ * still go to the global counter; they all happen with preemption off, so
+ * once every CPU has scheduled the counter is moved past them as well.
+ */
+asmlinkage long sys_set_unique_id_scope(int scope)
+{
+	struct pid_namespace *ns = task_active_pid_ns(current);
+	struct unique_id_counter *c;
+
+	switch (scope) {
+	case UNIQUE_ID_SCOPE_GLOBAL:
+		return ns->unique_id ? -EBUSY : 0;
+	case UNIQUE_ID_SCOPE_PID_NS:
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (ns == &init_pid_ns)
+		return -EINVAL;
+	if (!ns_capable(ns->user_ns, CAP_SYS_ADMIN))
+		return -EPERM;
+	if (ns->unique_id)
+		return 0;
+
+	c = kzalloc(sizeof(*c), GFP_KERNEL);
+	if (!c)
+		return -ENOMEM;
+	c->leases = alloc_percpu(struct uuid_lease);
+	if (!c->leases) {
+		kfree(c);
+		return -ENOMEM;
+	}
+
+	atomic64_set(&c->id, atomic64_read(&uuid_global.id));
+
+	/* Someone else in the namespace may have beaten us to it */
+	if (cmpxchg(&ns->unique_id, NULL, c) != NULL) {
+		unique_id_ns_free(c);
+		return 0;
+	}
+
+	synchronize_sched();
+	uuid_catch_up(c);
+
+	return 0;
+}
+
+void unique_id_ns_free(struct unique_id_counter *c)
+{
+	if (!c)
+		return;
+
+	free_percpu(c->leases);
+	kfree(c);
 }
@@ -18,6 +18,7 @@
 #include <linux/proc_ns.h>
 #include <linux/reboot.h>
 #include <linux/export.h>
+#include <linux/unique_id.h>
 
 struct pid_cache {
 	int nr_ids;
@@ -146,6 +147,7 @@ static void destroy_pid_namespace(struct pid_namespace *ns)
 	for (i = 0; i < PIDMAP_ENTRIES; i++)
 		kfree(ns->pidmap[i].page);
 	put_user_ns(ns->user_ns);
+	unique_id_ns_free(ns->unique_id);
 	call_rcu(&ns->rcu, delayed_free_pidns);
 }
 
@@ -74,6 +74,7 @@
 #include <linux/binfmts.h>
 #include <linux/context_tracking.h>
 #include <linux/compiler.h>
+#include <linux/unique_id.h>
 
 #include <asm/switch_to.h>
 #include <asm/tlb.h>
@@ -2326,6 +2327,9 @@ asmlinkage __visible void schedule_tail(struct task_struct *prev)
 
 	if (current->set_child_tid)
 		put_user(task_pid_vnr(current), current->set_child_tid);
+
+	if (current->unique_id_lease)
+		unique_id_lease_fork();
 }
 
 /*
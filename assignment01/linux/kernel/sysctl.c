@@ -105,6 +105,8 @@ extern unsigned int core_pipe_limit;
 #endif
 extern int pid_max;
 extern int pid_max_min, pid_max_max;
+extern int sysctl_unique_id_lease;
+extern int unique_id_lease_min, unique_id_lease_max;
 extern int percpu_pagelist_fraction;
 extern int compat_log;
 extern int latencytop_enabled;
@@ -762,6 +764,15 @@ static struct ctl_table kern_table[] = {
 		.extra1		= &pid_max_min,
 		.extra2		= &pid_max_max,
 	},
+	{
+		.procname	= "unique_id_lease",
+		.data		= &sysctl_unique_id_lease,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &unique_id_lease_min,
+		.extra2		= &unique_id_lease_max,
+	},
 	{
 		.procname	= "panic_on_oops",
 		.data		= &panic_on_oops,
@@ -0,0 +1,126 @@
+# child-pids-unique-id-hist.py - latency histograms for the ID syscalls
+#
+# This software may be distributed under the terms of the GNU General
+# Public License ("GPL") version 2 as published by the Free Software
+# Foundation.
+#
+# Turns the unique_id:* and child_pids:* tracepoints into per-syscall
+# histograms of the time spent in the call, of the number of tasks
+# scanned by the child_pids calls, and of the tasklist_lock hold times.
+#
+# usage: perf script -s child-pids-unique-id-hist.py
+
+import os
+import sys
+
+sys.path.append(os.environ['PERF_EXEC_PATH'] + \
+	'/scripts/python/Perf-Trace-Util/lib/Perf/Trace')
+
+from perf_trace_context import *
+from Core import *
+from Util import *
+
+# Must match enum unique_id_call and enum child_pids_call
+unique_id_calls = { 0: "get_unique_id", 1: "get_unique_id64",
+		    2: "get_unique_ids" }
+child_pids_calls = { 0: "get_child_pids", 1: "get_child_pids_page",
+		     2: "get_descendant_pids" }
+
+# Calls in flight, by tid: (name, entry time in ns)
+in_flight = {}
+
+latency = autodict()	# name -> log2 bucket -> count
+scanned = autodict()	# name -> log2 bucket -> count
+lock_hold = autodict()	# log2 bucket -> count
+ids_issued = autodict()	# name -> count
+errors = autodict()	# name -> count
+
+def bucket(value):
+	b = 0
+	while value > 1:
+		value >>= 1
+		b += 1
+	return b
+
+def inc(d, key):
+	try:
+		d[key] += 1
+	except TypeError:
+		d[key] = 1
+
+def add(d, key, value):
+	try:
+		d[key] += value
+	except TypeError:
+		d[key] = value
+
+def trace_begin():
+	print("Tracing ID syscalls... Ctrl-C to end.")
+
+# The tracepoint fields always come last; older perf versions don't pass
+# a callchain after common_comm, so they are taken from the end of args.
+def enter(name, secs, nsecs_, pid):
+	in_flight[pid] = (name, nsecs(secs, nsecs_))
+
+def leave(name, secs, nsecs_, pid, ret):
+	start = in_flight.pop(pid, None)
+	if start is not None and start[0] == name:
+		inc(latency[name], bucket(nsecs(secs, nsecs_) - start[1]))
+	if ret < 0:
+		inc(errors, name)
+
+def unique_id__unique_id_enter(event_name, context, common_cpu,
+		common_secs, common_nsecs, common_pid, common_comm, *args):
+	call = args[-1]
+	enter(unique_id_calls.get(call, str(call)), common_secs,
+	      common_nsecs, common_pid)
+
+def unique_id__unique_id_exit(event_name, context, common_cpu,
+		common_secs, common_nsecs, common_pid, common_comm, *args):
+	call, first, count, ret = args[-4:]
+	name = unique_id_calls.get(call, str(call))
+	leave(name, common_secs, common_nsecs, common_pid, ret)
+	if ret == 0:
+		add(ids_issued, name, count)
+
+def child_pids__child_pids_enter(event_name, context, common_cpu,
+		common_secs, common_nsecs, common_pid, common_comm, *args):
+	call, limit = args[-2:]
+	enter(child_pids_calls.get(call, str(call)), common_secs,
+	      common_nsecs, common_pid)
+
+def child_pids__child_pids_exit(event_name, context, common_cpu,
+		common_secs, common_nsecs, common_pid, common_comm, *args):
+	call, nr_scanned, copied, ret = args[-4:]
+	name = child_pids_calls.get(call, str(call))
+	leave(name, common_secs, common_nsecs, common_pid, ret)
+	inc(scanned[name], bucket(nr_scanned))
+
+def child_pids__child_pids_lock(event_name, context, common_cpu,
+		common_secs, common_nsecs, common_pid, common_comm, *args):
+	inc(lock_hold, bucket(args[-1]))
+
+def print_hist(title, unit, hist):
+	total = sum(hist.values())
+	if total == 0:
+		return
+	print("\n%s (%d samples)" % (title, total))
+	print("%24s %10s  %s" % (unit, "count", "distribution"))
+	for b in range(min(hist.keys()), max(hist.keys()) + 1):
+		n = hist.get(b, 0)
+		if isinstance(n, dict):
+			n = 0
+		bar = "#" * int(40 * n / total)
+		print("%11d -> %-10d %10d |%-40s|" % \
+			((1 << b) if b else 0, (1 << (b + 1)) - 1, n, bar))
+
+def trace_end():
+	for name in sorted(latency.keys()):
+		print_hist("%s latency" % name, "ns", latency[name])
+		if name in ids_issued:
+			print("IDs issued: %d" % ids_issued[name])
+		if name in errors:
+			print("errors: %d" % errors[name])
+	for name in sorted(scanned.keys()):
+		print_hist("%s tasks scanned" % name, "tasks", scanned[name])
+	print_hist("tasklist_lock hold time", "ns", lock_hold)
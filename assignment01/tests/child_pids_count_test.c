@@ -0,0 +1,124 @@
+// Stress test for the child counter behind get_child_pids(NULL, 0, &n).
+// The main thread forks children which fork a grandchild and exit, so the
+// grandchildren get reparented to us (we are a subreaper) while a second
+// thread reaps everything concurrently. Every CHECK_EVERY forks the O(1)
+// count must match a full walk of the children list, and both must drop
+// to zero once everything has been reaped.
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include "syscalls.h"
+
+#define ITERATIONS 20000
+#define CHECK_EVERY 100
+#define MAX_CHILDREN 65536
+
+pthread_mutex_t count_mutex = PTHREAD_MUTEX_INITIALIZER;
+volatile int expected = 0;	// processes that will have to be reaped
+volatile int reaped = 0;
+volatile int done = 0;
+
+pid_t pid_list[MAX_CHILDREN];
+
+void *reaperThread(void *vargp)
+{
+	int status;
+	pid_t pid;
+
+	while (!done || reaped < expected) {
+		pthread_mutex_lock(&count_mutex);
+		pid = waitpid(-1, &status, WNOHANG);
+		if (pid > 0) {
+			reaped++;
+			// a child exiting with 0 has forked a grandchild
+			if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+				expected++;
+		}
+		pthread_mutex_unlock(&count_mutex);
+		if (pid <= 0)
+			usleep(100);
+	}
+	return NULL;
+}
+
+// get_child_pids, where ENOBUFS only means the list did not fit
+static void child_pids(pid_t *buf, size_t limit, size_t *n)
+{
+	long res = get_child_pids(buf, limit, n);
+
+	if (res != 0 && res != ENOBUFS) {
+		printf("get_child_pids returned an error!\n");
+		exit(1);
+	}
+}
+
+// Count as seen by the O(1) path, made stable by reading it around the walk
+void check_count(int iteration)
+{
+	size_t fast = 0, fast_after = 0, walked = 0;
+
+	do {
+		child_pids(NULL, 0, &fast);
+		child_pids(pid_list, MAX_CHILDREN, &walked);
+		child_pids(NULL, 0, &fast_after);
+	} while (fast != fast_after);
+
+	if (fast != walked) {
+		printf("Iteration %d: counter says %zu children, list has %zu!\n",
+		       iteration, fast, walked);
+		exit(1);
+	}
+}
+
+int main()
+{
+	pthread_t reaper;
+	size_t n = 0;
+	int i;
+
+	if (get_child_pids(NULL, 0, &n) == ENOSYS) {
+		printf("get_child_pids not available on this architecture, skipped\n");
+		return 0;
+	}
+
+	prctl(PR_SET_CHILD_SUBREAPER, 1);
+	pthread_create(&reaper, NULL, reaperThread, NULL);
+
+	for (i = 0; i < ITERATIONS; i++) {
+		pid_t pid = fork();
+
+		if (pid < 0) {
+			printf("Fork failed %i \n", pid);
+			exit(1);
+		}
+		if (pid == 0) {
+			pid_t grandchild = fork();
+
+			if (grandchild == 0)
+				_exit(0x7f);
+			_exit(grandchild < 0);
+		}
+
+		pthread_mutex_lock(&count_mutex);
+		expected++;
+		pthread_mutex_unlock(&count_mutex);
+
+		if (i % CHECK_EVERY == 0)
+			check_count(i);
+	}
+
+	done = 1;
+	pthread_join(reaper, NULL);
+
+	child_pids(NULL, 0, &n);
+	if (n != 0) {
+		printf("Everything was reaped but counter says %zu children!\n", n);
+		exit(1);
+	}
+
+	printf("Things look good!\n");
+	return 0;
+}
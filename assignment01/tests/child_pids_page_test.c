@@ -0,0 +1,90 @@
+// Forks NR_CHILDREN children which exit at random times, and pages
+// through them with get_child_pids_page while they do. Every page must
+// be sorted, strictly after the cursor, and contain only our children.
+// Run with a high enough process limit (ulimit -u).
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include "syscalls.h"
+
+#define NR_CHILDREN 10000
+#define PAGE_SIZE 256
+#define PASSES 20
+
+pid_t children[NR_CHILDREN];
+
+int cmp_pid(const void *a, const void *b)
+{
+	pid_t x = *(const pid_t *)a;
+	pid_t y = *(const pid_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+int is_child(pid_t pid)
+{
+	return bsearch(&pid, children, NR_CHILDREN, sizeof(pid_t), cmp_pid) != NULL;
+}
+
+int main()
+{
+	pid_t page[PAGE_SIZE];
+	unsigned int nr;
+	int pass;
+	int i;
+
+	// Children sleep up to 2s, so they exit while we are paging
+	for (i = 0; i < NR_CHILDREN; i++) {
+		children[i] = fork();
+		if (children[i] < 0) {
+			printf("Fork failed after %d children\n", i);
+			exit(1);
+		}
+		if (children[i] == 0) {
+			srand(getpid());
+			usleep(rand() % 2000000);
+			_exit(0);
+		}
+	}
+	qsort(children, NR_CHILDREN, sizeof(pid_t), cmp_pid);
+
+	for (pass = 0; pass < PASSES; pass++) {
+		pid_t cursor = 0;
+		size_t total = 0;
+
+		do {
+			if (get_child_pids_page(page, PAGE_SIZE, cursor, &nr) != 0) {
+				printf("get_child_pids_page returned an error!\n");
+				exit(1);
+			}
+			for (i = 0; i < nr; i++) {
+				if (page[i] <= cursor) {
+					printf("pid %d returned after cursor %d!\n",
+					       page[i], cursor);
+					exit(1);
+				}
+				if (!is_child(page[i])) {
+					printf("pid %d is not one of our children!\n",
+					       page[i]);
+					exit(1);
+				}
+				cursor = page[i];
+			}
+			total += nr;
+		} while (nr == PAGE_SIZE);
+
+		printf("Pass %d: %zu children\n", pass, total);
+
+		// Reap whoever exited so far
+		while (waitpid(-1, NULL, WNOHANG) > 0)
+			;
+	}
+
+	while (wait(NULL) > 0)
+		;
+
+	printf("Things look good!\n");
+	return 0;
+}
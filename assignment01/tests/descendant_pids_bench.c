@@ -0,0 +1,162 @@
+// Builds a 3-level process tree (FANOUT x FANOUT x LEAVES_PER_NODE, i.e.
+// 10k leaves) and compares rebuilding it with one get_descendant_pids
+// call against asking every node for its direct children with
+// get_child_pids, which is what a per-node walk costs. get_child_pids
+// only lists the caller's own children, so each node times its call
+// itself, one node at a time, and the per-node total is the sum.
+// Run with a high enough process limit (ulimit -u).
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "syscalls.h"
+
+#define FANOUT 10
+#define LEAVES_PER_NODE 100
+#define NR_LEAVES (FANOUT * FANOUT * LEAVES_PER_NODE)
+#define NR_NODES (FANOUT + FANOUT * FANOUT + NR_LEAVES)
+#define ROUNDS 20
+
+struct descendant_pid tree[NR_NODES];
+
+// What a node reports about its get_child_pids calls
+struct node_time {
+	double seconds;	// for all ROUNDS calls
+	long err;	// errno of the first failed call, or 0
+};
+
+int ready[2];	// every leaf writes one byte once it is up
+int quit[2];	// closed by the benchmark to tear the tree down
+int token[2];	// one byte, passed on so nodes time one at a time
+int times[2];	// a struct node_time per node
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Lists the caller's children ROUNDS times, checking there are nr
+static struct node_time time_children(size_t nr)
+{
+	pid_t pids[LEAVES_PER_NODE];
+	struct node_time t = { 0, 0 };
+	double start = now();
+	size_t found;
+	int round;
+
+	for (round = 0; round < ROUNDS; round++) {
+		t.err = get_child_pids(pids, LEAVES_PER_NODE, &found);
+		if (t.err)
+			return t;
+		if (found != nr) {
+			t.err = -1;
+			return t;
+		}
+	}
+	t.seconds = now() - start;
+	return t;
+}
+
+// Forks nr children at level depth, each one then builds its own subtree
+static void spawn(int depth, int nr)
+{
+	struct node_time t;
+	char c;
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		pid_t pid = fork();
+
+		if (pid < 0) {
+			printf("Fork failed\n");
+			exit(1);
+		}
+		if (pid > 0)
+			continue;
+
+		close(quit[1]);
+		if (depth < 3)
+			spawn(depth + 1, depth == 2 ? LEAVES_PER_NODE : FANOUT);
+		else
+			write(ready[1], "x", 1);
+
+		// Our turn in the per-node walk
+		read(token[0], &c, 1);
+		t = time_children(depth == 3 ? 0 :
+				  depth == 2 ? LEAVES_PER_NODE : FANOUT);
+		write(times[1], &t, sizeof(t));
+		write(token[1], &c, 1);
+
+		// Wait for the benchmark to be over, then reap our children
+		read(quit[0], &c, 1);
+		while (wait(NULL) > 0)
+			;
+		_exit(0);
+	}
+}
+
+int main()
+{
+	struct node_time t;
+	unsigned int nr;
+	double start, t_one, t_per_node;
+	int round;
+	int i;
+	char c;
+
+	pipe(ready);
+	pipe(quit);
+	pipe(token);
+	pipe(times);
+	spawn(1, FANOUT);
+	for (i = 0; i < NR_LEAVES; i++)
+		read(ready[0], &c, 1);
+
+	// One call for the whole tree
+	start = now();
+	for (round = 0; round < ROUNDS; round++) {
+		if (get_descendant_pids(0, tree, NR_NODES, 3, &nr) != 0) {
+			printf("get_descendant_pids returned an error!\n");
+			exit(1);
+		}
+	}
+	t_one = (now() - start) / ROUNDS;
+	if (nr != NR_NODES) {
+		printf("Expected %d descendants, got %u\n", NR_NODES, nr);
+		exit(1);
+	}
+
+	// One get_child_pids call per node, ours first, then the tree's
+	t = time_children(FANOUT);
+	t_per_node = t.seconds;
+	write(token[1], "x", 1);
+	for (i = 0; i < NR_NODES; i++) {
+		struct node_time node;
+
+		read(times[0], &node, sizeof(node));
+		t_per_node += node.seconds;
+		if (!t.err)
+			t.err = node.err;
+	}
+	t_per_node /= ROUNDS;
+
+	printf("%d nodes\n", NR_NODES);
+	printf("one call:      %8.3f ms\n", t_one * 1e3);
+	if (t.err == ENOSYS)
+		printf("one per node:  get_child_pids not available, skipped\n");
+	else if (t.err)
+		printf("one per node:  get_child_pids returned an error!\n");
+	else
+		printf("one per node:  %8.3f ms (%d calls)\n",
+		       t_per_node * 1e3, NR_NODES + 1);
+
+	close(quit[1]);
+	while (wait(NULL) > 0)
+		;
+
+	return 0;
+}
@@ -0,0 +1,76 @@
+// LSD radix sort of 64-bit keys, 8 bits per pass, used to check large
+// sets of ids for duplicates (and to sort latencies) in O(n).
+#include <stdlib.h>
+#include <string.h>
+
+// Sorts a[0..n-1], tmp must hold n keys. Digits that are zero in every
+// key are skipped, so small keys only take a few passes.
+static void radix_sort_u64(unsigned long long *a, unsigned long long *tmp, size_t n)
+{
+	unsigned long long *src = a, *dst = tmp, *swap;
+	unsigned long long all = 0;
+	size_t count[257];
+	size_t i;
+	int shift;
+
+	for (i = 0; i < n; i++)
+		all |= a[i];
+
+	for (shift = 0; shift < 64; shift += 8) {
+		if (((all >> shift) & 0xff) == 0)
+			continue;
+
+		memset(count, 0, sizeof(count));
+		for (i = 0; i < n; i++)
+			count[((src[i] >> shift) & 0xff) + 1]++;
+		for (i = 1; i < 257; i++)
+			count[i] += count[i - 1];
+		for (i = 0; i < n; i++)
+			dst[count[(src[i] >> shift) & 0xff]++] = src[i];
+
+		swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	if (src != a)
+		memcpy(a, src, n * sizeof(*a));
+}
+
+// Looks for a value present twice in ids[0..n-1], which gets sorted.
+// Returns 1 and stores it in *dup if there is one, 0 otherwise.
+static int find_duplicate(unsigned long long *ids, size_t n, unsigned long long *dup)
+{
+	unsigned long long *tmp;
+	unsigned long long min = ~0ULL;
+	size_t i;
+
+	if (n < 2)
+		return 0;
+
+	// Rebase on the smallest id so that fewer digits are significant
+	for (i = 0; i < n; i++)
+		if (ids[i] < min)
+			min = ids[i];
+	for (i = 0; i < n; i++)
+		ids[i] -= min;
+
+	tmp = malloc(n * sizeof(*tmp));
+	if (tmp == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+	radix_sort_u64(ids, tmp, n);
+	free(tmp);
+
+	for (i = 0; i < n; i++)
+		ids[i] += min;
+
+	for (i = 1; i < n; i++) {
+		if (ids[i] == ids[i - 1]) {
+			*dup = ids[i];
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,231 @@
+// Benchmark driver for the assignment01 syscalls.
+//
+// For get_unique_id64 and get_child_pids, sweeps the number of threads
+// (1, 2, 4, ... up to max_threads), pins thread i to CPU i % nr_cpus and
+// reports the throughput and per-call latency percentiles. The ids drawn
+// are checked for duplicates with a radix sort, in O(n). A syscall not
+// wired up for this architecture (get_child_pids on x86_64) is skipped.
+//
+// usage: ./syscall_bench [max_threads] [calls_per_thread]
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "syscalls.h"
+#include "radix_sort.h"
+
+#define CHILDREN_PER_THREAD 16
+#define CHILD_PIDS_LIMIT 64
+
+enum bench { BENCH_UNIQUE_ID, BENCH_CHILD_PIDS, NR_BENCHES };
+
+static const char * const bench_names[] = {
+	[BENCH_UNIQUE_ID]	= "get_unique_id64",
+	[BENCH_CHILD_PIDS]	= "get_child_pids",
+};
+
+struct thread_arg {
+	int cpu;
+	enum bench bench;
+	unsigned long long *latencies;	// calls_per_thread entries
+	unsigned long long *ids;	// calls_per_thread entries, or NULL
+};
+
+static long calls_per_thread = 200000;
+static int nr_cpus;
+static pthread_barrier_t start_barrier;
+static int quit[2];	// children of get_child_pids block on it
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void pin(int cpu)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// Children only count for the thread that forked them
+static void fork_children(int nr)
+{
+	char c;
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		pid_t pid = fork();
+
+		if (pid < 0) {
+			printf("Fork failed\n");
+			exit(1);
+		}
+		if (pid == 0) {
+			close(quit[1]);
+			read(quit[0], &c, 1);
+			_exit(0);
+		}
+	}
+}
+
+void *startThread(void *vargp)
+{
+	struct thread_arg *arg = vargp;
+	pid_t pids[CHILD_PIDS_LIMIT];
+	unsigned long long uuid, t;
+	size_t nr;
+	long i;
+
+	pin(arg->cpu);
+	if (arg->bench == BENCH_CHILD_PIDS)
+		fork_children(CHILDREN_PER_THREAD);
+
+	pthread_barrier_wait(&start_barrier);
+	for (i = 0; i < calls_per_thread; i++) {
+		t = now_ns();
+		switch (arg->bench) {
+		case BENCH_UNIQUE_ID:
+			if (get_unique_id64(&uuid) != 0) {
+				printf("get_unique_id64 returned an error!\n");
+				exit(1);
+			}
+			arg->ids[i] = uuid;
+			break;
+		case BENCH_CHILD_PIDS:
+			if (get_child_pids(pids, CHILD_PIDS_LIMIT, &nr) != 0) {
+				printf("get_child_pids returned an error!\n");
+				exit(1);
+			}
+			break;
+		default:
+			break;
+		}
+		arg->latencies[i] = now_ns() - t;
+	}
+	pthread_barrier_wait(&start_barrier);
+
+	return NULL;
+}
+
+// ENOSYS where the syscall is not wired up for this architecture
+static long probe(enum bench bench)
+{
+	unsigned long long uuid;
+	size_t nr;
+	long res;
+
+	switch (bench) {
+	case BENCH_UNIQUE_ID:
+		return get_unique_id64(&uuid);
+	case BENCH_CHILD_PIDS:
+		// Only counts the children; ENOBUFS just means there are some
+		res = get_child_pids(NULL, 0, &nr);
+		return res == ENOBUFS ? 0 : res;
+	default:
+		return 0;
+	}
+}
+
+static unsigned long long percentile(unsigned long long *sorted, size_t n, double p)
+{
+	return sorted[(size_t)(p * (n - 1))];
+}
+
+static void run(enum bench bench, int nr_threads)
+{
+	size_t n = (size_t)nr_threads * calls_per_thread;
+	unsigned long long *latencies, *ids = NULL, *tmp, dup;
+	struct thread_arg args[nr_threads];
+	pthread_t tids[nr_threads];
+	unsigned long long start, elapsed;
+	int i;
+
+	latencies = malloc(n * sizeof(*latencies));
+	tmp = malloc(n * sizeof(*tmp));
+	if (bench == BENCH_UNIQUE_ID)
+		ids = malloc(n * sizeof(*ids));
+	if (latencies == NULL || tmp == NULL ||
+	    (bench == BENCH_UNIQUE_ID && ids == NULL)) {
+		perror("malloc");
+		exit(1);
+	}
+
+	pipe(quit);
+	pthread_barrier_init(&start_barrier, NULL, nr_threads + 1);
+	for (i = 0; i < nr_threads; i++) {
+		args[i].cpu = i % nr_cpus;
+		args[i].bench = bench;
+		args[i].latencies = latencies + (size_t)i * calls_per_thread;
+		args[i].ids = ids ? ids + (size_t)i * calls_per_thread : NULL;
+		pthread_create(&tids[i], NULL, startThread, &args[i]);
+	}
+
+	// Start and end barriers, so thread creation isn't measured
+	pthread_barrier_wait(&start_barrier);
+	start = now_ns();
+	pthread_barrier_wait(&start_barrier);
+	elapsed = now_ns() - start;
+
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(tids[i], NULL);
+	pthread_barrier_destroy(&start_barrier);
+
+	close(quit[1]);
+	close(quit[0]);
+	while (wait(NULL) > 0)
+		;
+
+	if (ids && find_duplicate(ids, n, &dup)) {
+		printf("The element %llu was generated twice!\n", dup);
+		exit(1);
+	}
+
+	radix_sort_u64(latencies, tmp, n);
+	printf("%-16s %7d %14.0f %8llu %8llu %8llu %8llu %10llu\n",
+	       bench_names[bench], nr_threads, n * 1e9 / elapsed,
+	       percentile(latencies, n, 0.50), percentile(latencies, n, 0.90),
+	       percentile(latencies, n, 0.99), percentile(latencies, n, 0.999),
+	       latencies[n - 1]);
+
+	free(latencies);
+	free(tmp);
+	free(ids);
+}
+
+int main(int argc, char **argv)
+{
+	int max_threads;
+	int bench, n;
+
+	nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	max_threads = nr_cpus;
+	if (argc > 1)
+		max_threads = atoi(argv[1]);
+	if (argc > 2)
+		calls_per_thread = atol(argv[2]);
+
+	printf("%-16s %7s %14s %8s %8s %8s %8s %10s\n", "syscall", "threads",
+	       "calls/s", "p50 ns", "p90 ns", "p99 ns", "p99.9 ns", "max ns");
+	for (bench = 0; bench < NR_BENCHES; bench++) {
+		if (probe(bench) == ENOSYS) {
+			printf("%-16s not available on this architecture, skipped\n",
+			       bench_names[bench]);
+			continue;
+		}
+		for (n = 1; n < max_threads; n *= 2)
+			run(bench, n);
+		run(bench, max_threads);
+	}
+
+	return 0;
+}
@@ -1,14 +1,82 @@
 #include <errno.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
+#include <unistd.h>
 
+#ifdef __x86_64__
+// Only wired up for i386 (and x32): -1 makes the kernel fail them with
+// ENOSYS, instead of some other syscall answering under the i386 number
+#define __NR_get_unique_id -1
+#define __NR_get_child_pids -1
+#define __NR_get_unique_ids 322
+#define __NR_set_unique_id_lease 323
+#define __NR_get_unique_id64 324
+#define __NR_get_child_pids_page 325
+#define __NR_get_descendant_pids 326
+#define __NR_set_unique_id_scope 327
+#else
 #define __NR_get_unique_id 358
 #define __NR_get_child_pids 359
+#define __NR_get_unique_ids 360
+#define __NR_set_unique_id_lease 361
+#define __NR_get_unique_id64 362
+#define __NR_get_child_pids_page 363
+#define __NR_get_descendant_pids 364
+#define __NR_set_unique_id_scope 365
+#endif
 
-inline long get_unique_id(int* uuid) {
+// Scopes for set_unique_id_scope, see <linux/unique_id.h>
+#define UNIQUE_ID_SCOPE_GLOBAL 0
+#define UNIQUE_ID_SCOPE_PID_NS 1
+
+// Same layout as struct unique_id_lease in <linux/unique_id.h>
+struct unique_id_lease {
+	int next;
+	int end;
+};
+
+// Same layout as struct descendant_pid in <linux/child_pids.h>
+struct descendant_pid {
+	pid_t pid;
+	pid_t ppid;
+	unsigned int depth;
+};
+
+static inline long get_unique_id(int* uuid) {
 	return syscall(__NR_get_unique_id, uuid) ? errno : 0;
 }
 
-inline long get_child_pids(pid_t* buf, size_t limit, size_t* num_children) {
+// 64-bit ids, never wrap (EOVERFLOW once exhausted)
+static inline long get_unique_id64(unsigned long long* uuid) {
+	return syscall(__NR_get_unique_id64, uuid) ? errno : 0;
+}
+
+// Gives the caller's pid namespace its own id counter
+static inline long set_unique_id_scope(int scope) {
+	return syscall(__NR_set_unique_id_scope, scope) ? errno : 0;
+}
+
+static inline long get_child_pids(pid_t* buf, size_t limit, size_t* num_children) {
 	return syscall(__NR_get_child_pids, buf, limit, num_children) ? errno : 0;
 }
+
+// Reserves n consecutive ids, the first one is stored in *first
+static inline long get_unique_ids(int* first, size_t n) {
+	return syscall(__NR_get_unique_ids, first, n) ? errno : 0;
+}
+
+// Registers the lease the vDSO serves ids from, so that it is emptied on fork
+static inline long set_unique_id_lease(struct unique_id_lease* lease) {
+	return syscall(__NR_set_unique_id_lease, lease) ? errno : 0;
+}
+
+// Children with a pid greater than cursor, in increasing pid order
+static inline long get_child_pids_page(pid_t* buf, size_t limit, pid_t cursor, unsigned int* num_children) {
+	return syscall(__NR_get_child_pids_page, buf, limit, cursor, num_children) ? errno : 0;
+}
+
+// Subtree of root (0 for the caller), at most max_depth levels deep
+static inline long get_descendant_pids(pid_t root, struct descendant_pid* buf, size_t limit,
+				       unsigned int max_depth, unsigned int* num_descendants) {
+	return syscall(__NR_get_descendant_pids, root, buf, limit, max_depth, num_descendants) ? errno : 0;
+}
@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <pthread.h>
 #include "syscalls.h"
+#include "radix_sort.h"
 
 #define DEBUG 0 // prints all uuids generated
 #define ARRAY_SIZE 20000000 // number of generated uuid
@@ -11,83 +12,70 @@
 
 const int cells_to_fill = ARRAY_SIZE / THREAD_NUMBER;
 
-volatile int running_threads = 0;
-pthread_mutex_t running_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-int array[ARRAY_SIZE];
+unsigned long long array[ARRAY_SIZE];
  
 void *startThread(void *vargp)
 {
     // Store the value argument passed to this thread
-    int myid = (int)vargp;
+    long myid = (long)vargp;
     
     if (DEBUG) {
-    	printf("Thread %d starting...\n", myid);
+    	printf("Thread %ld starting...\n", myid);
     }
     // Where to start filling array
     int start = myid * cells_to_fill;
     int end = start + cells_to_fill;
     
-    int uuid;
+    unsigned long long uuid;
     
     int i;
     for (i = start; i < end; i++) {
 	if (DEBUG) {
 		printf("tid %d running\n");
 	}
-		if (get_unique_id(&uuid) != 0) {
-			printf("get_unique_id returned an error!\n");
+		if (get_unique_id64(&uuid) != 0) {
+			printf("get_unique_id64 returned an error!\n");
 			exit(1);
 		}
 		array[i] = uuid;
 	}
-	
-	pthread_mutex_lock(&running_mutex);
-	running_threads--;
-	pthread_mutex_unlock(&running_mutex);
+
+	return NULL;
 }
 
-// Searches for repetitions
+// Searches for repetitions, in O(n) by radix sorting the array
 void arrayContainsDouble() {
-	int i;
-	int j;
-	for (i = 0; i < ARRAY_SIZE; i++) {
-		for (j = 0; j < ARRAY_SIZE; j++) {
-			if ( (array[i] == array[j]) && (i != j) ) {
-				printf("The element %d was generated twice!\n", array[i]);
-				exit(0);
-			}
-		}
+	unsigned long long dup;
+
+	if (find_duplicate(array, ARRAY_SIZE, &dup)) {
+		printf("The element %llu was generated twice!\n", dup);
+		exit(1);
 	}
-	
+
 	printf("\nNo repetition found for %d calls!\n", ARRAY_SIZE);
 }
  
 int main()
 {
-    int i;
-    pthread_t tid;
+    long i;
+    pthread_t tids[THREAD_NUMBER];
  
     // Create THREAD_NUMBER threads
     printf("Creating threads...\n");
     for (i = 0; i < THREAD_NUMBER ; i++) {
-		pthread_mutex_lock(&running_mutex);
-		running_threads++;
-		pthread_mutex_unlock(&running_mutex);
-		
-        pthread_create(&tid, NULL, startThread, (void *)i);
+        pthread_create(&tids[i], NULL, startThread, (void *)i);
     }
     
     // Wait for all threads to finish working
-    while (running_threads > 0) {
-		sleep(1);
+    for (i = 0; i < THREAD_NUMBER; i++) {
+		pthread_join(tids[i], NULL);
 	}
     
     // Display array
     if (DEBUG) {
 		printf("\nGenerated UUIDs: \n");
 		for (i = 0; i < ARRAY_SIZE; i++) {
-			printf("%d, ", i, array[i]);
+			printf("%llu, ", array[i]);
 		}
 	}
 	
@@ -0,0 +1,185 @@
+// Runs NR_TENANTS pid namespaces in parallel, each hammering get_unique_id64
+// from THREADS_PER_TENANT threads, once with every namespace on the global
+// counter and once with a private counter per namespace. Each tenant's
+// throughput is compared with the throughput it gets when running alone.
+// First checks that a namespace switching to its own counter never hands
+// out an ID it already drew from the global one.
+// Must be run as root (unshare(CLONE_NEWPID)).
+//
+// usage: ./uniq_ns_bench [tenants] [threads_per_tenant]
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "syscalls.h"
+
+#define CALLS_PER_THREAD 2000000
+#define SWITCH_IDS 1000		// drawn on each side of the scope switch
+
+int nr_tenants = 4;
+int threads_per_tenant = 2;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void *startThread(void *vargp)
+{
+	unsigned long long uuid;
+	int i;
+
+	for (i = 0; i < CALLS_PER_THREAD; i++) {
+		if (get_unique_id64(&uuid) != 0) {
+			printf("get_unique_id64 returned an error!\n");
+			exit(1);
+		}
+	}
+	return NULL;
+}
+
+// Body of a tenant: pid 1 of its namespace. Waits on go, reports calls/s
+static void tenant(int scope, int go, int result)
+{
+	pthread_t tids[threads_per_tenant];
+	double start, rate;
+	char c;
+	int i;
+
+	if (set_unique_id_scope(scope) != 0) {
+		printf("set_unique_id_scope returned an error!\n");
+		exit(1);
+	}
+
+	read(go, &c, 1);
+	start = now();
+	for (i = 0; i < threads_per_tenant; i++)
+		pthread_create(&tids[i], NULL, startThread, NULL);
+	for (i = 0; i < threads_per_tenant; i++)
+		pthread_join(tids[i], NULL);
+
+	rate = (double)threads_per_tenant * CALLS_PER_THREAD / (now() - start);
+	write(result, &rate, sizeof(rate));
+	exit(0);
+}
+
+static int cmp_ull(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+// Draws IDs, switches the namespace to its own counter, draws again
+static void check_scope_switch(void)
+{
+	unsigned long long ids[2 * SWITCH_IDS];
+	int status, i;
+
+	if (fork() == 0) {
+		if (unshare(CLONE_NEWPID) != 0) {
+			printf("unshare failed, are you root?\n");
+			exit(1);
+		}
+		if (fork() == 0) {
+			for (i = 0; i < 2 * SWITCH_IDS; i++) {
+				if (i == SWITCH_IDS &&
+				    set_unique_id_scope(UNIQUE_ID_SCOPE_PID_NS) != 0) {
+					printf("set_unique_id_scope returned an error!\n");
+					exit(1);
+				}
+				if (get_unique_id64(&ids[i]) != 0) {
+					printf("get_unique_id64 returned an error!\n");
+					exit(1);
+				}
+			}
+			qsort(ids, 2 * SWITCH_IDS, sizeof(ids[0]), cmp_ull);
+			for (i = 1; i < 2 * SWITCH_IDS; i++) {
+				if (ids[i] == ids[i - 1]) {
+					printf("The element %llu was generated twice across the scope switch!\n",
+					       ids[i]);
+					exit(1);
+				}
+			}
+			exit(0);
+		}
+		wait(&status);
+		exit(WIFEXITED(status) ? WEXITSTATUS(status) : 1);
+	}
+	wait(&status);
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		exit(1);
+	printf("scope switch: no ID handed out twice\n");
+}
+
+// Runs n tenants at once, returns the mean calls/s of a tenant
+static double run(int n, int scope)
+{
+	int go[2], result[2];
+	double rate, total = 0;
+	int i;
+
+	pipe(go);
+	pipe(result);
+	for (i = 0; i < n; i++) {
+		if (fork() == 0) {
+			close(go[1]);
+			close(result[0]);
+			if (unshare(CLONE_NEWPID) != 0) {
+				printf("unshare failed, are you root?\n");
+				exit(1);
+			}
+			if (fork() == 0)
+				tenant(scope, go[0], result[1]);
+			wait(NULL);
+			exit(0);
+		}
+	}
+
+	close(go[1]);		// starts everybody at once
+	for (i = 0; i < n; i++) {
+		read(result[0], &rate, sizeof(rate));
+		total += rate;
+	}
+	while (wait(NULL) > 0)
+		;
+	close(go[0]);
+	close(result[0]);
+	close(result[1]);
+
+	return total / n;
+}
+
+int main(int argc, char **argv)
+{
+	static const char * const names[] = { "global", "pid_ns" };
+	int scope;
+
+	if (argc > 1)
+		nr_tenants = atoi(argv[1]);
+	if (argc > 2)
+		threads_per_tenant = atoi(argv[2]);
+
+	check_scope_switch();
+
+	printf("%d tenants, %d threads each\n", nr_tenants, threads_per_tenant);
+	printf("%8s %18s %18s %10s\n", "counter", "alone (calls/s)",
+	       "shared (calls/s)", "slowdown");
+	for (scope = UNIQUE_ID_SCOPE_GLOBAL; scope <= UNIQUE_ID_SCOPE_PID_NS; scope++) {
+		double alone = run(1, scope);
+		double shared = run(nr_tenants, scope);
+
+		printf("%8s %18.0f %18.0f %9.2fx\n", names[scope], alone,
+		       shared, alone / shared);
+	}
+
+	return 0;
+}
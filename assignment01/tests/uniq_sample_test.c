@@ -17,5 +17,17 @@ int main () {
 	res = get_unique_id((int*)47424742); // arbitrary memory address
 	printf ( "Syscall returned %d \n", res);
 
+	printf("Batch call of 100 ids\n"); fflush(stdout);
+	res = get_unique_ids(&uuid, 100);
+	printf("Syscall returned %d, ids are %d to %d\n", res, uuid, uuid + 99);
+
+	printf("Call after the batch\n"); fflush(stdout);
+	res = get_unique_id(&uuid);
+	printf("Syscall returned %d, uuid is %d\n", res, uuid);
+
+	printf("Empty batch call\n"); fflush(stdout);
+	res = get_unique_ids(&uuid, 0);
+	printf("Syscall returned %d \n", res);
+
 	return 0;
 }
@@ -0,0 +1,129 @@
+// Scaling report for the unique ID counter, through get_unique_id64 (wired
+// up on i386 and x86_64 alike).
+//
+// Runs 1..N threads (N defaults to the number of online CPUs) with a lease
+// size of 1, where every call is one atomic add on the shared counter, and
+// with per-CPU leases of lease_size IDs, and prints the throughput of each.
+// The old spinlock implementation is gone: the lease=1 column is the
+// unbatched atomic path, not that.
+// Must be run as root since it changes /proc/sys/kernel/unique_id_lease.
+//
+// usage: ./uniq_scaling_test [max_threads] [lease_size]
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include "syscalls.h"
+
+#define LEASE_SYSCTL "/proc/sys/kernel/unique_id_lease"
+#define CALLS_PER_THREAD 1000000
+#define DEFAULT_LEASE 64
+
+static pthread_barrier_t start_barrier;
+
+static int read_lease(void)
+{
+	FILE *f = fopen(LEASE_SYSCTL, "r");
+	int lease = -1;
+
+	if (f == NULL)
+		return -1;
+	if (fscanf(f, "%d", &lease) != 1)
+		lease = -1;
+	fclose(f);
+	return lease;
+}
+
+static int write_lease(int lease)
+{
+	FILE *f = fopen(LEASE_SYSCTL, "w");
+
+	if (f == NULL)
+		return -1;
+	fprintf(f, "%d\n", lease);
+	return fclose(f);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void *startThread(void *vargp)
+{
+	unsigned long long uuid;
+	int i;
+
+	pthread_barrier_wait(&start_barrier);
+	for (i = 0; i < CALLS_PER_THREAD; i++) {
+		if (get_unique_id64(&uuid) != 0) {
+			printf("get_unique_id64 returned an error!\n");
+			exit(1);
+		}
+	}
+	return NULL;
+}
+
+// Returns the number of calls per second achieved by nr_threads threads
+static double run(int nr_threads)
+{
+	pthread_t tids[nr_threads];
+	double start;
+	int i;
+
+	pthread_barrier_init(&start_barrier, NULL, nr_threads + 1);
+	for (i = 0; i < nr_threads; i++)
+		pthread_create(&tids[i], NULL, startThread, NULL);
+
+	pthread_barrier_wait(&start_barrier);
+	start = now();
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(tids[i], NULL);
+
+	pthread_barrier_destroy(&start_barrier);
+	return (double)nr_threads * CALLS_PER_THREAD / (now() - start);
+}
+
+int main(int argc, char **argv)
+{
+	int max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int lease = DEFAULT_LEASE;
+	int saved_lease;
+	int n;
+
+	if (argc > 1)
+		max_threads = atoi(argv[1]);
+	if (argc > 2)
+		lease = atoi(argv[2]);
+
+	saved_lease = read_lease();
+	if (saved_lease < 0) {
+		printf("Cannot read %s, is the kernel patched?\n", LEASE_SYSCTL);
+		return 1;
+	}
+
+	printf("%8s %18s %18s %8s\n", "threads", "atomic (calls/s)",
+	       "leased (calls/s)", "speedup");
+	for (n = 1; n <= max_threads; n++) {
+		double old_rate, new_rate;
+
+		if (write_lease(1) != 0) {
+			printf("Cannot write %s, are you root?\n", LEASE_SYSCTL);
+			return 1;
+		}
+		old_rate = run(n);
+
+		write_lease(lease);
+		new_rate = run(n);
+
+		printf("%8d %18.0f %18.0f %7.2fx\n", n, old_rate, new_rate,
+		       new_rate / old_rate);
+	}
+
+	write_lease(saved_lease);
+	return 0;
+}
@@ -0,0 +1,112 @@
+// Compares the cost of get_unique_id through the vDSO lease with the
+// plain syscall path, in ns per ID. Also checks that a forked child gets
+// a fresh lease instead of handing out its parent's IDs.
+// The vDSO is only built for x86_64, compile with: make uniq_vdso_bench
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "syscalls.h"
+
+#define ITERATIONS 10000000
+
+typedef long (*vdso_get_unique_id_t)(int *uuid, struct unique_id_lease *lease);
+
+static vdso_get_unique_id_t vdso_get_unique_id;
+static __thread struct unique_id_lease lease;
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double bench_syscall(void)
+{
+	double start = now_ns();
+	int uuid;
+	int i;
+
+	for (i = 0; i < ITERATIONS; i++) {
+		if (get_unique_ids(&uuid, 1) != 0) {
+			printf("get_unique_ids returned an error!\n");
+			exit(1);
+		}
+	}
+	return (now_ns() - start) / ITERATIONS;
+}
+
+static double bench_vdso(void)
+{
+	double start = now_ns();
+	int uuid;
+	int i;
+
+	for (i = 0; i < ITERATIONS; i++) {
+		if (vdso_get_unique_id(&uuid, &lease) != 0) {
+			printf("__vdso_get_unique_id returned an error!\n");
+			exit(1);
+		}
+	}
+	return (now_ns() - start) / ITERATIONS;
+}
+
+// The child must not reuse what is left of the parent's lease
+static int check_fork(void)
+{
+	int parent_id, child_id;
+	int fds[2];
+	pid_t pid;
+
+	vdso_get_unique_id(&parent_id, &lease);
+	if (pipe(fds) != 0)
+		return -1;
+
+	pid = fork();
+	if (pid < 0)
+		return -1;
+	if (pid == 0) {
+		vdso_get_unique_id(&child_id, &lease);
+		write(fds[1], &child_id, sizeof(child_id));
+		_exit(0);
+	}
+
+	read(fds[0], &child_id, sizeof(child_id));
+	waitpid(pid, NULL, 0);
+	vdso_get_unique_id(&parent_id, &lease);
+
+	return child_id == parent_id;
+}
+
+int main()
+{
+	void *vdso;
+
+	vdso = dlopen("linux-vdso.so.1", RTLD_LAZY | RTLD_LOCAL | RTLD_NOLOAD);
+	if (vdso)
+		vdso_get_unique_id = (vdso_get_unique_id_t)
+			dlsym(vdso, "__vdso_get_unique_id");
+	if (vdso_get_unique_id == NULL) {
+		printf("__vdso_get_unique_id not found, is the kernel patched?\n");
+		return 1;
+	}
+
+	if (set_unique_id_lease(&lease) != 0) {
+		printf("set_unique_id_lease returned an error!\n");
+		return 1;
+	}
+
+	if (check_fork() != 0) {
+		printf("Parent and child handed out the same id after fork!\n");
+		return 1;
+	}
+
+	printf("syscall: %6.1f ns/id\n", bench_syscall());
+	printf("vdso:    %6.1f ns/id\n", bench_vdso());
+
+	return 0;
+}
@@ -0,0 +1,206 @@
+// Throughput, overrun and latency benchmark for /dev/comN.
+//
+// Meant for the loopback emulation (make EMULATED=1), where everything
+// written to a port comes back on it. For each RX trigger level (1, 4, 8,
+// 14 and adaptive) it streams a counting pattern through the port and
+// reports the throughput, the bytes lost, the emulator's overrun count,
+// the RX interrupt rate and the reader wakeups per KB. It then bounces
+// single bytes to report the round-trip latency percentiles.
+//
+// usage: ./uart_bench [device] [kilobytes] [pings]
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include "../uart16550.h"
+
+#define OVERRUNS_PARAM "/sys/module/uart16550/parameters/emu_overruns"
+#define CHUNK 4096
+#define IDLE_TIMEOUT_MS 1000	// stream considered over after this long
+
+struct stream {
+	int fd;
+	long bytes;
+};
+
+static const unsigned int levels[] = {
+	UART16550_TRIGGER_1,
+	UART16550_TRIGGER_4,
+	UART16550_TRIGGER_8,
+	UART16550_TRIGGER_14,
+	UART16550_TRIGGER_ADAPTIVE,
+};
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// -1 when not running on the emulated backend
+static long read_overruns(void)
+{
+	FILE *f = fopen(OVERRUNS_PARAM, "r");
+	long overruns = -1;
+
+	if (!f)
+		return -1;
+	if (fscanf(f, "%ld", &overruns) != 1)
+		overruns = -1;
+	fclose(f);
+	return overruns;
+}
+
+static void *writer(void *arg)
+{
+	struct stream *s = arg;
+	unsigned char buf[CHUNK];
+	long sent = 0, i;
+	ssize_t n;
+
+	while (sent < s->bytes) {
+		long len = s->bytes - sent < CHUNK ? s->bytes - sent : CHUNK;
+
+		for (i = 0; i < len; i++)
+			buf[i] = (sent + i) & 0xff;
+		n = write(s->fd, buf, len);
+		if (n < 0) {
+			perror("write");
+			break;
+		}
+		sent += n;
+	}
+	return NULL;
+}
+
+// Reads the counting pattern back; returns the bytes received and counts
+// the bytes missing from the sequence in *lost
+static long drain(int fd, long bytes, long *lost)
+{
+	unsigned char buf[CHUNK], expected = 0;
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	long received = 0;
+	ssize_t n, i;
+
+	*lost = 0;
+	while (received + *lost < bytes) {
+		if (poll(&pfd, 1, IDLE_TIMEOUT_MS) <= 0)
+			break;
+		n = read(fd, buf, sizeof(buf));
+		if (n <= 0)
+			break;
+		for (i = 0; i < n; i++) {
+			// Bytes are dropped, not corrupted: a gap means losses
+			*lost += (unsigned char)(buf[i] - expected);
+			expected = buf[i] + 1;
+		}
+		received += n;
+	}
+	// Whatever never showed up was lost as well
+	if (received + *lost < bytes)
+		*lost = bytes - received;
+	return received;
+}
+
+static int cmp_ull(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void run_level(int fd, unsigned int level, long bytes, int pings)
+{
+	struct uart16550_trigger_info trigger;
+	struct uart16550_wakeup_info before, after;
+	unsigned long long start, elapsed, *latencies;
+	struct stream s = { .fd = fd, .bytes = bytes };
+	long received, lost, overruns;
+	pthread_t thread;
+	unsigned char byte = 0x5a;
+	char label[16];
+	int i;
+
+	if (ioctl(fd, UART16550_IOCTL_SET_TRIGGER, level)) {
+		perror("UART16550_IOCTL_SET_TRIGGER");
+		return;
+	}
+
+	// Sustained throughput
+	overruns = read_overruns();
+	ioctl(fd, UART16550_IOCTL_GET_WAKEUPS, &before);
+	start = now_ns();
+	pthread_create(&thread, NULL, writer, &s);
+	received = drain(fd, bytes, &lost);
+	elapsed = now_ns() - start;
+	pthread_join(thread, NULL);
+	ioctl(fd, UART16550_IOCTL_GET_TRIGGER, &trigger);
+	ioctl(fd, UART16550_IOCTL_GET_WAKEUPS, &after);
+	if (overruns >= 0)
+		overruns = read_overruns() - overruns;
+
+	// Round trip of single bytes
+	latencies = malloc(pings * sizeof(*latencies));
+	for (i = 0; i < pings; i++) {
+		start = now_ns();
+		if (write(fd, &byte, 1) != 1 || read(fd, &byte, 1) != 1) {
+			perror("ping");
+			break;
+		}
+		latencies[i] = now_ns() - start;
+	}
+	pings = i;
+	qsort(latencies, pings, sizeof(*latencies), cmp_ull);
+
+	if (level)
+		snprintf(label, sizeof(label), "%u", level);
+	else
+		snprintf(label, sizeof(label), "adaptive");
+	printf("%-8s %10.1f %8ld %9ld %9u %10.2f", label,
+			received / 1024.0 / (elapsed / 1e9), lost, overruns,
+			trigger.irqs_per_sec,
+			received ? (after.rx_wakeups - before.rx_wakeups) *
+				1024.0 / received : 0.0);
+	if (pings)
+		printf(" %8llu %8llu %8llu", latencies[pings / 2] / 1000,
+				latencies[pings * 99 / 100] / 1000,
+				latencies[pings - 1] / 1000);
+	printf("\n");
+	free(latencies);
+}
+
+int main(int argc, char **argv)
+{
+	const char *device = argc > 1 ? argv[1] : "/dev/com1";
+	long kilobytes = argc > 2 ? atol(argv[2]) : 256;
+	int pings = argc > 3 ? atoi(argv[3]) : 1000;
+	unsigned int i;
+	int fd;
+
+	fd = open(device, O_RDWR);
+	if (fd < 0) {
+		perror(device);
+		return 1;
+	}
+
+	if (read_overruns() < 0)
+		printf("%s not found, overruns are not counted\n", OVERRUNS_PARAM);
+
+	printf("%-8s %10s %8s %9s %9s %10s %8s %8s %8s\n", "trigger", "KB/s",
+			"lost", "overruns", "rx irq/s", "wakeup/KB",
+			"p50 us", "p99 us", "max us");
+	for (i = 0; i < sizeof(levels) / sizeof(levels[0]); i++)
+		run_level(fd, levels[i], kilobytes * 1024, pings);
+
+	close(fd);
+	return 0;
+}
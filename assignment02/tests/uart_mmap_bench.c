@@ -0,0 +1,219 @@
+// CPU cost of consuming /dev/comN through read() versus the mmap()ed ring.
+//
+// Meant for the loopback emulation (make EMULATED=1), where everything
+// written to a port comes back on it. Each mode streams a counting pattern
+// through the port while the consumer thread checks it, blocking in poll()
+// only when nothing is buffered. Reported per mode: the throughput, the
+// bytes lost, the consumer's CPU time per MB and its syscalls per MB.
+//
+// usage: ./uart_mmap_bench [device] [kilobytes]
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include "../uart16550.h"
+
+#define CHUNK 4096
+#define IDLE_TIMEOUT_MS 1000	// stream considered over after this long
+
+struct stream {
+	int fd;
+	long bytes;
+	struct uart16550_mmap_header *header;	// NULL in read() mode
+	unsigned char *rx, *tx;
+};
+
+struct result {
+	long received, lost, syscalls;
+	unsigned long long cpu_ns;
+};
+
+static unsigned long long clock_ns(clockid_t clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *writer(void *arg)
+{
+	struct stream *s = arg;
+	unsigned char buf[CHUNK];
+	long sent = 0, i;
+	ssize_t n;
+
+	while (sent < s->bytes) {
+		long len = s->bytes - sent < CHUNK ? s->bytes - sent : CHUNK;
+
+		for (i = 0; i < len; i++)
+			buf[i] = (sent + i) & 0xff;
+		n = write(s->fd, buf, len);
+		if (n < 0) {
+			perror("write");
+			break;
+		}
+		sent += n;
+	}
+	return NULL;
+}
+
+// Fills the TX ring, kicking the driver after each batch
+static void *ring_writer(void *arg)
+{
+	struct stream *s = arg;
+	struct uart16550_ring *ring = &s->header->tx;
+	struct pollfd pfd = { .fd = s->fd, .events = POLLOUT };
+	unsigned int head = ring->head, tail, room, i;
+	long sent = 0;
+
+	while (sent < s->bytes) {
+		tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+		room = ring->size - (head - tail);
+		if (!room) {
+			poll(&pfd, 1, IDLE_TIMEOUT_MS);
+			continue;
+		}
+		if (room > s->bytes - sent)
+			room = s->bytes - sent;
+		for (i = 0; i < room; i++)
+			s->tx[(head + i) % ring->size] = (sent + i) & 0xff;
+		head += room;
+		__atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+		sent += room;
+		if (ioctl(s->fd, UART16550_IOCTL_MMAP_KICK)) {
+			perror("UART16550_IOCTL_MMAP_KICK");
+			break;
+		}
+	}
+	return NULL;
+}
+
+// Bytes are dropped, not corrupted: a gap in the pattern means losses
+static void check(const unsigned char *buf, long n, unsigned char *expected,
+		long *lost)
+{
+	long i;
+
+	for (i = 0; i < n; i++) {
+		*lost += (unsigned char)(buf[i] - *expected);
+		*expected = buf[i] + 1;
+	}
+}
+
+static void consume_read(struct stream *s, struct result *r)
+{
+	unsigned char buf[CHUNK], expected = 0;
+	struct pollfd pfd = { .fd = s->fd, .events = POLLIN };
+	ssize_t n;
+
+	while (r->received + r->lost < s->bytes) {
+		r->syscalls += 2;
+		if (poll(&pfd, 1, IDLE_TIMEOUT_MS) <= 0)
+			break;
+		n = read(s->fd, buf, sizeof(buf));
+		if (n <= 0)
+			break;
+		check(buf, n, &expected, &r->lost);
+		r->received += n;
+	}
+}
+
+static void consume_ring(struct stream *s, struct result *r)
+{
+	struct uart16550_ring *ring = &s->header->rx;
+	struct pollfd pfd = { .fd = s->fd, .events = POLLIN };
+	unsigned int head, tail = ring->tail, start, len;
+	unsigned char expected = 0;
+
+	while (r->received + r->lost < s->bytes) {
+		head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		if (head == tail) {
+			// Only syscall of the loop: nothing left to consume
+			r->syscalls++;
+			if (poll(&pfd, 1, IDLE_TIMEOUT_MS) <= 0)
+				break;
+			continue;
+		}
+		// Up to the end of the ring, the rest on the next pass
+		start = tail % ring->size;
+		len = head - tail;
+		if (len > ring->size - start)
+			len = ring->size - start;
+		check(s->rx + start, len, &expected, &r->lost);
+		tail += len;
+		__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+		r->received += len;
+	}
+}
+
+static void run(const char *device, int use_mmap, long bytes)
+{
+	struct stream s = { .bytes = bytes };
+	struct result r = { 0 };
+	unsigned long long start, elapsed;
+	long size = UART16550_MMAP_SIZE(sysconf(_SC_PAGESIZE));
+	pthread_t thread;
+	void *area = NULL;
+
+	s.fd = open(device, O_RDWR);
+	if (s.fd < 0) {
+		perror(device);
+		return;
+	}
+	if (use_mmap) {
+		area = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+				s.fd, 0);
+		if (area == MAP_FAILED) {
+			perror("mmap");
+			close(s.fd);
+			return;
+		}
+		s.header = area;
+		s.rx = (unsigned char *)area + s.header->rx.offset;
+		s.tx = (unsigned char *)area + s.header->tx.offset;
+	}
+
+	start = clock_ns(CLOCK_MONOTONIC);
+	pthread_create(&thread, NULL, use_mmap ? ring_writer : writer, &s);
+	r.cpu_ns = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+	if (use_mmap)
+		consume_ring(&s, &r);
+	else
+		consume_read(&s, &r);
+	r.cpu_ns = clock_ns(CLOCK_THREAD_CPUTIME_ID) - r.cpu_ns;
+	elapsed = clock_ns(CLOCK_MONOTONIC) - start;
+	pthread_join(thread, NULL);
+
+	// Whatever never showed up was lost as well
+	if (r.received + r.lost < bytes)
+		r.lost = bytes - r.received;
+
+	printf("%-6s %10.1f %8ld %14.3f %12.1f\n", use_mmap ? "mmap" : "read",
+			r.received / 1024.0 / (elapsed / 1e9), r.lost,
+			r.received ? r.cpu_ns / 1e6 / (r.received / 1048576.0) : 0.0,
+			r.received ? r.syscalls / (r.received / 1048576.0) : 0.0);
+
+	if (area)
+		munmap(area, size);
+	close(s.fd);
+}
+
+int main(int argc, char **argv)
+{
+	const char *device = argc > 1 ? argv[1] : "/dev/com1";
+	long kilobytes = argc > 2 ? atol(argv[2]) : 256;
+
+	printf("%-6s %10s %8s %14s %12s\n", "mode", "KB/s", "lost",
+			"cpu ms/MB", "syscalls/MB");
+	run(device, 0, kilobytes * 1024);
+	run(device, 1, kilobytes * 1024);
+	return 0;
+}
@@ -9,12 +9,59 @@
 #include <linux/kfifo.h>
 #include <linux/sched.h>
 #include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/mutex.h>
 #include <linux/interrupt.h>
+#include <linux/jiffies.h>
+#include <linux/hrtimer.h>
+#include <linux/spinlock.h>
+#include <linux/percpu.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/irq.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/uaccess.h>
 #include "uart16550.h"
 #include "uart16550_hw.h"
 
 #define MODULE_NAME	"uart16550"
 
+/* Events passed from the hard interrupt handler to the IRQ thread */
+#define EVENT_RX		0
+#define EVENT_RX_BURST_END	1
+#define EVENT_TX		2
+
+/*
+ * RTS/CTS: RTS drops once the RX ring holds FLOW_HIGH_WATERMARK bytes,
+ * leaving room for what the other end still has in flight, and is raised
+ * again once readers take it down to FLOW_LOW_WATERMARK.
+ */
+#define FLOW_HIGH_WATERMARK	(FIFO_SIZE - 4 * UART16550_FIFO_DEPTH)
+#define FLOW_LOW_WATERMARK	(FIFO_SIZE / 2)
+
+/* mmap()ed rings, laid out as described in uart16550.h */
+#define SHARED_RING_SIZE	FIFO_SIZE
+#define SHARED_RX_OFFSET	PAGE_SIZE
+#define SHARED_TX_OFFSET	(PAGE_SIZE + UART16550_MMAP_RING_SIZE(PAGE_SIZE))
+#define SHARED_AREA_SIZE	UART16550_MMAP_SIZE(PAGE_SIZE)
+
+/* Shared IRQ: passes over the ports before giving up on a stuck line */
+#define IRQ_PASS_LIMIT		16
+
+/* Polled mode: empty polls after which the port goes back to interrupts */
+#define POLL_IDLE_LIMIT		16
+
+/* Histogram of RX bytes per interrupt: 0..FIFO depth, then "more" */
+#define HIST_BUCKETS		(UART16550_FIFO_DEPTH + 2)
+
+/* Adaptive trigger: length of the observation window */
+#define ADAPT_WINDOW		(HZ / 10)
+/* Adaptive trigger: RX interrupt rate above which bytes are batched more */
+#define ADAPT_IRQ_RATE		1000
+
 MODULE_DESCRIPTION("Uart16550 driver");
 MODULE_LICENSE("GPL");
 
@@ -27,22 +74,102 @@ MODULE_LICENSE("GPL");
 
 static struct class *uart16550_class = NULL;
 
-static struct cdev *uart_cdev_com1;
-static struct cdev *uart_cdev_com2;
+static struct dentry *uart16550_debugfs;
+
+/*
+ * Per-CPU port statistics, so the interrupt path and the readers and
+ * writers on other CPUs never bounce a shared counter line. Only u64
+ * fields, sum_stats() adds them up as an array.
+ */
+struct port_stats {
+	u64 rx_bytes, tx_bytes;
+	u64 irqs;
+	u64 polls;		/* Services by the polled mode timer */
+	u64 overruns;		/* LSR OE: lost in the hardware FIFO */
+	u64 rx_drops;		/* Lost to a full RX ring */
+	u64 rx_wakeups, tx_wakeups;
+	u64 read_wait_ns, write_wait_ns;
+	u64 rx_per_irq[HIST_BUCKETS];
+};
 
+/*
+ * Each direction is a single producer / single consumer kfifo: the
+ * interrupt handler is the only producer of read_fifo and the only
+ * consumer of write_fifo, so neither side takes a lock. Concurrent
+ * readers (or writers) are serialized among themselves by read_lock
+ * (write_lock) to keep the other end single.
+ */
 struct device_data {
 	struct cdev cdev;
 	int baseport;
-	char read_buffer[FIFO_SIZE];
-	char write_buffer[FIFO_SIZE];
-	atomic_t read_fill;
-	atomic_t write_fill;
-	int read_get;
-	int read_put;
-	int write_put;
-	int write_get;
+	int irq;
+	int minor;
+	/* Set up as far as: hardware, character device */
+	int have_hw, have_cdev;
+	/* On the ports of its irq_group */
+	struct list_head irq_node;
+	/*
+	 * Serializes the interrupt handler, the poll timer and line changes,
+	 * so only one of them at a time consumes the kfifos' IRQ side.
+	 */
+	spinlock_t hw_lock;
+	/* Interrupts enabled outside polled mode */
+	int ier;
+	/* RTS dropped because the RX ring is nearly full */
+	int rx_throttled;
+	/* Polled mode wanted, and currently serviced by poll_timer */
+	int polled, polling;
+	unsigned int idle_polls;
+	u64 poll_period_ns;
+	struct hrtimer poll_timer;
+	DECLARE_KFIFO(read_fifo, uint8_t, FIFO_SIZE);
+	DECLARE_KFIFO(write_fifo, uint8_t, FIFO_SIZE);
+	struct mutex read_lock, write_lock;
 	wait_queue_head_t wq_reads, wq_writes;
-} devs[2];
+	struct fasync_struct *async_queue;
+	/*
+	 * While the port is mmap()ed, the rings in shared_area replace the
+	 * kfifos. shared is only switched under hw_lock; rx_head and tx_tail
+	 * are the driver's own copies of the indices it produces, so nothing
+	 * userspace writes to the header can mislead it.
+	 */
+	struct mutex mmap_lock;
+	int mappings;
+	void *shared_area;
+	struct uart16550_mmap_header *shared;
+	unsigned int rx_head, tx_tail;
+	unsigned long events;
+	struct port_stats __percpu *stats;
+	struct uart16550_line_info line;
+	/* RX trigger level, only changed with the IRQ held off */
+	int rx_trigger;
+	int adaptive;
+	/* RX interrupt observations, only touched by the interrupt handler */
+	struct {
+		unsigned long start;
+		unsigned int rx_irqs, rx_timeouts, rx_bytes;
+		unsigned int irqs_per_sec;
+	} window;
+};
+
+/* The ports sharing an IRQ line, which is requested once for all of them */
+struct irq_group {
+	int irq;
+	int requested;
+	struct list_head ports;
+	struct list_head node;
+};
+
+static struct device_data *devs[MAX_NUMBER_DEVICES];
+static int nr_devs;
+static LIST_HEAD(irq_groups);
+
+static const int trigger_levels[] = {
+	UART16550_TRIGGER_1,
+	UART16550_TRIGGER_4,
+	UART16550_TRIGGER_8,
+	UART16550_TRIGGER_14
+};
 
 /*
  * TODO: Populate major number from module options (when it is given).
@@ -55,16 +182,322 @@ module_param(major, int, 0);
 static int behavior = 0x3;
 module_param(behavior, int, 0);
 
-static int uart16550_ioctl(struct inode *inode, struct file *file, unsigned int ioctl_num, unsigned long ioctl_param) {
-	/* TODO */
+/*
+ * Ports of multi-port cards, as baseports=0x3f8,0x2f8,... irqs=4,3,...
+ * When given, they replace COM1/COM2 and behavior; port i is /dev/com<i+1>.
+ */
+static int baseports[MAX_NUMBER_DEVICES];
+static int nr_baseports;
+module_param_array(baseports, int, &nr_baseports, 0);
+
+static int irqs[MAX_NUMBER_DEVICES];
+static int nr_irq_params;
+module_param_array(irqs, int, &nr_irq_params, 0);
+
+/* Service ports with an hrtimer instead of interrupts while they are busy */
+static bool polled;
+module_param(polled, bool, 0);
+
+/* Readers are woken once the RX ring holds this many bytes, or a burst ends */
+static unsigned int rx_watermark = 64;
+module_param(rx_watermark, uint, 0644);
+
+/* Writers are woken once the TX ring drains down to this many bytes */
+static unsigned int tx_watermark = FIFO_SIZE / 4;
+module_param(tx_watermark, uint, 0644);
+
+static void sum_stats(struct device_data *data, struct port_stats *sum)
+{
+	u64 *total = (u64 *)sum;
+	u64 *part;
+	int cpu, i;
+
+	memset(sum, 0, sizeof(*sum));
+	for_each_possible_cpu(cpu) {
+		part = (u64 *)per_cpu_ptr(data->stats, cpu);
+		for (i = 0; i < sizeof(*sum) / sizeof(u64); i++)
+			total[i] += part[i];
+	}
+}
+
+static int trigger_index(int rx_trigger)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(trigger_levels); i++)
+		if (trigger_levels[i] == rx_trigger)
+			return i;
+	return -1;
+}
+
+/* Half the hardware FIFO's worth of characters, leaving room for jitter */
+static u64 poll_period(struct uart16550_line_info line)
+{
+	return (u64)uart16550_hw_char_time_ns(line) * (UART16550_FIFO_DEPTH / 2);
+}
+
+/*
+ * The shared rings' indices come from userspace: whatever they hold, the
+ * driver never counts more than the ring size between them.
+ */
+static unsigned int shared_used(unsigned int head, unsigned int tail)
+{
+	return min_t(unsigned int, head - tail, SHARED_RING_SIZE);
+}
+
+static int shared_rx_in(struct device_data *data, uint8_t *buf, int count)
+{
+	struct uart16550_ring *ring = &data->shared->rx;
+	uint8_t *bytes = data->shared_area + SHARED_RX_OFFSET;
+	unsigned int head = data->rx_head;
+	int i;
+
+	count = min_t(int, count, SHARED_RING_SIZE -
+			shared_used(head, ACCESS_ONCE(ring->tail)));
+	/* Read tail before writing to the slots it handed back */
+	smp_mb();
+	for (i = 0; i < count; i++)
+		bytes[(head + i) & (SHARED_RING_SIZE - 1)] = buf[i];
+	/* The bytes, then the head that makes them visible */
+	smp_wmb();
+	data->rx_head = head + count;
+	ACCESS_ONCE(ring->head) = data->rx_head;
+	return count;
+}
+
+static int shared_tx_out(struct device_data *data, uint8_t *buf, int count)
+{
+	struct uart16550_ring *ring = &data->shared->tx;
+	uint8_t *bytes = data->shared_area + SHARED_TX_OFFSET;
+	unsigned int tail = data->tx_tail;
+	int i;
+
+	count = min_t(int, count, shared_used(ACCESS_ONCE(ring->head), tail));
+	/* The head, then the bytes it covers */
+	smp_rmb();
+	for (i = 0; i < count; i++)
+		buf[i] = bytes[(tail + i) & (SHARED_RING_SIZE - 1)];
+	/* Done reading the slots before handing them back */
+	smp_mb();
+	data->tx_tail = tail + count;
+	ACCESS_ONCE(ring->tail) = data->tx_tail;
+	return count;
+}
+
+/* The RX and TX rings: the kfifos, or the shared rings while mmap()ed */
+static int rx_ring_in(struct device_data *data, uint8_t *buf, int count)
+{
+	if (data->shared)
+		return shared_rx_in(data, buf, count);
+	return kfifo_in(&data->read_fifo, buf, count);
+}
+
+static unsigned int rx_ring_len(struct device_data *data)
+{
+	struct uart16550_mmap_header *shared = ACCESS_ONCE(data->shared);
+
+	if (shared)
+		return shared_used(ACCESS_ONCE(data->rx_head),
+				ACCESS_ONCE(shared->rx.tail));
+	return kfifo_len(&data->read_fifo);
+}
+
+static int tx_ring_out(struct device_data *data, uint8_t *buf, int count)
+{
+	if (data->shared)
+		return shared_tx_out(data, buf, count);
+	return kfifo_out(&data->write_fifo, buf, count);
+}
+
+static unsigned int tx_ring_len(struct device_data *data)
+{
+	struct uart16550_mmap_header *shared = ACCESS_ONCE(data->shared);
+
+	if (shared)
+		return shared_used(ACCESS_ONCE(shared->tx.head),
+				ACCESS_ONCE(data->tx_tail));
+	return kfifo_len(&data->write_fifo);
+}
+
+/* Drained enough for the other end to resume sending */
+static void rx_unthrottle(struct device_data *data)
+{
+	unsigned long flags;
+
+	if (!ACCESS_ONCE(data->rx_throttled) ||
+			rx_ring_len(data) > FLOW_LOW_WATERMARK)
+		return;
+	spin_lock_irqsave(&data->hw_lock, flags);
+	if (data->rx_throttled) {
+		uart16550_hw_set_rts(data->baseport, 1);
+		data->rx_throttled = 0;
+	}
+	spin_unlock_irqrestore(&data->hw_lock, flags);
+}
+
+/* THRE may already be idle, have it raised again to start sending */
+static void kick_tx(struct device_data *data)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&data->hw_lock, flags);
+	if (!data->polling) {
+		uart16550_hw_disable_interrupts(data->baseport);
+		uart16550_hw_set_interrupts(data->baseport, data->ier);
+	}
+	spin_unlock_irqrestore(&data->hw_lock, flags);
+}
+
+/*
+ * Whether every field of line is one of its UART16550_* values. Anything
+ * else could set DLAB in LCR or program a zero divisor.
+ */
+static int line_valid(const struct uart16550_line_info *line)
+{
+	switch (line->baud) {
+	case UART16550_BAUD_1200:
+	case UART16550_BAUD_2400:
+	case UART16550_BAUD_4800:
+	case UART16550_BAUD_9600:
+	case UART16550_BAUD_19200:
+	case UART16550_BAUD_38400:
+	case UART16550_BAUD_56000:
+	case UART16550_BAUD_115200:
+		break;
+	default:
+		return 0;
+	}
+
+	switch (line->len) {
+	case UART16550_LEN_5:
+	case UART16550_LEN_6:
+	case UART16550_LEN_7:
+	case UART16550_LEN_8:
+		break;
+	default:
+		return 0;
+	}
+
+	switch (line->par) {
+	case UART16550_PAR_NONE:
+	case UART16550_PAR_ODD:
+	case UART16550_PAR_EVEN:
+	case UART16550_PAR_STICK:
+	case UART16550_PAR_ODD | UART16550_PAR_STICK:
+	case UART16550_PAR_EVEN | UART16550_PAR_STICK:
+		break;
+	default:
+		return 0;
+	}
+
+	if (line->stop != UART16550_STOP_1 && line->stop != UART16550_STOP_2)
+		return 0;
+
+	return line->flow == UART16550_FLOW_NONE ||
+		line->flow == UART16550_FLOW_RTSCTS;
+}
+
+static long uart16550_ioctl(struct file *file, unsigned int ioctl_num, unsigned long ioctl_param) {
+	struct device_data *data = file->private_data;
+	struct uart16550_line_info line;
+	struct uart16550_trigger_info info;
+	struct uart16550_wakeup_info wakeups;
+	struct port_stats stats;
+	unsigned long flags;
+	int rx_trigger;
+
 	dprintk("[uart debug] uart16550_ioctl()\n");
-	return 0;
+
+	switch (ioctl_num) {
+	case UART16550_IOCTL_SET_LINE:
+		if (copy_from_user(&line, (void __user *)ioctl_param, sizeof(line)))
+			return -EFAULT;
+		if (!line_valid(&line))
+			return -EINVAL;
+		spin_lock_irqsave(&data->hw_lock, flags);
+		data->line = line;
+		data->poll_period_ns = poll_period(line);
+		data->ier = UART16550_IER_RDAI | UART16550_IER_THREI;
+		if (line.flow == UART16550_FLOW_RTSCTS)
+			data->ier |= UART16550_IER_MSI;
+		uart16550_hw_set_line_parameters(data->baseport, line,
+				data->rx_trigger);
+		/* Ready to receive, flow control drops it when full */
+		uart16550_hw_set_rts(data->baseport, 1);
+		data->rx_throttled = 0;
+		uart16550_hw_set_interrupts(data->baseport,
+				data->polling ? 0 : data->ier);
+		spin_unlock_irqrestore(&data->hw_lock, flags);
+		return 0;
+
+	case UART16550_IOCTL_SET_TRIGGER:
+		rx_trigger = ioctl_param;
+		if (rx_trigger != UART16550_TRIGGER_ADAPTIVE &&
+				trigger_index(rx_trigger) < 0)
+			return -EINVAL;
+		/* The handler bursts rx_trigger bytes, keep it in sync with FCR */
+		spin_lock_irqsave(&data->hw_lock, flags);
+		data->adaptive = (rx_trigger == UART16550_TRIGGER_ADAPTIVE);
+		if (!data->adaptive) {
+			data->rx_trigger = rx_trigger;
+			uart16550_hw_set_rx_trigger(data->baseport, rx_trigger);
+		}
+		spin_unlock_irqrestore(&data->hw_lock, flags);
+		return 0;
+
+	case UART16550_IOCTL_SET_POLLED:
+		/*
+		 * Takes effect on the next interrupt; when turned off, the
+		 * poll timer hands the port back to interrupts by itself.
+		 */
+		ACCESS_ONCE(data->polled) = !!ioctl_param;
+		return 0;
+
+	case UART16550_IOCTL_GET_WAKEUPS:
+		sum_stats(data, &stats);
+		wakeups.rx_bytes = stats.rx_bytes;
+		wakeups.tx_bytes = stats.tx_bytes;
+		wakeups.rx_wakeups = stats.rx_wakeups;
+		wakeups.tx_wakeups = stats.tx_wakeups;
+		if (copy_to_user((void __user *)ioctl_param, &wakeups,
+					sizeof(wakeups)))
+			return -EFAULT;
+		return 0;
+
+	case UART16550_IOCTL_GET_TRIGGER:
+		info.level = ACCESS_ONCE(data->rx_trigger);
+		info.adaptive = data->adaptive;
+		info.irqs_per_sec = ACCESS_ONCE(data->window.irqs_per_sec);
+		info.latency_ns = info.level *
+			uart16550_hw_char_time_ns(data->line);
+		if (copy_to_user((void __user *)ioctl_param, &info, sizeof(info)))
+			return -EFAULT;
+		return 0;
+
+	case UART16550_IOCTL_MMAP_KICK:
+		if (!ACCESS_ONCE(data->shared))
+			return -EINVAL;
+		/* Userspace consumed RX and produced TX behind our back */
+		rx_unthrottle(data);
+		kick_tx(data);
+		return 0;
+	}
+
+	return -ENOTTY;
+}
+
+static int uart16550_fasync(int fd, struct file *file, int on)
+{
+	struct device_data *data = file->private_data;
+
+	return fasync_helper(fd, file, on, &data->async_queue);
 }
 
 /* Called when a process closes the device file */
 static int uart16550_release(struct inode *inode, struct file *file) {
-	/* TODO */
 	dprintk("[uart debug] uart16550_release()\n");
+	/* Stop SIGIO to this file */
+	uart16550_fasync(-1, file, 0);
 	return 0;
 }
 
@@ -77,72 +510,578 @@ static int uart16550_open(struct inode * inode, struct file * file) {
 	return 0;
 }
 
-static int uart16550_read(struct file *file,
-   char *user_buffer,    /* The buffer to fill with data */
+static ssize_t uart16550_read(struct file *file,
+   char __user *user_buffer,    /* The buffer to fill with data */
    size_t size,   /* The length of the buffer     */
    loff_t *offset)  /* Our offset in the file       */ {
-   	/* TODO */
-   	dprintk("[uart debug] uart16550_read()\n");
-   	
-   	return 0;
-   }
+	struct device_data *data = file->private_data;
+	unsigned int bytes_copied;
+	ktime_t start;
+	int ret;
+
+	dprintk("[uart debug] uart16550_read()\n");
+
+	/* mmap()ed: the bytes go to the shared ring instead */
+	if (ACCESS_ONCE(data->shared))
+		return -EBUSY;
+
+	if (file->f_flags & O_NONBLOCK) {
+		if (!mutex_trylock(&data->read_lock))
+			return -EAGAIN;
+		ret = !kfifo_is_empty(&data->read_fifo) ? 0 : -EAGAIN;
+	} else {
+		if (mutex_lock_interruptible(&data->read_lock))
+			return -ERESTARTSYS;
+		/* Block until the interrupt handler has put something in */
+		start = ktime_get();
+		ret = wait_event_interruptible(data->wq_reads,
+				!kfifo_is_empty(&data->read_fifo) ||
+				ACCESS_ONCE(data->shared));
+		this_cpu_add(data->stats->read_wait_ns,
+				ktime_to_ns(ktime_sub(ktime_get(), start)));
+		if (!ret && ACCESS_ONCE(data->shared))
+			ret = -EBUSY;
+	}
+	if (!ret)
+		ret = kfifo_to_user(&data->read_fifo, user_buffer, size,
+				&bytes_copied);
+
+	rx_unthrottle(data);
+
+	mutex_unlock(&data->read_lock);
+
+	return ret ? ret : bytes_copied;
+}
 
 /* To write data from userspace to the device */
-static int uart16550_write(struct file *file, const char *user_buffer,
+static ssize_t uart16550_write(struct file *file, const char __user *user_buffer,
         size_t size, loff_t *offset)
 {
+	struct device_data *data = file->private_data;
+	unsigned int bytes_copied;
+	ktime_t start;
+	int ret;
+
 	dprintk("[uart debug] uart16550_write()\n");
-        /*int bytes_copied;
-        uint32_t device_port;*/
-        /*
-         * TODO: Write the code that takes the data provided by the
-         *      user from userspace and stores it in the kernel
-         *      device outgoing buffer.
-         * TODO: Populate bytes_copied with the number of bytes
-         *      that fit in the outgoing buffer.
-         */
-
-        /*uart16550_hw_force_interrupt_reemit(device_port);
-
-        return bytes_copied;*/
-        
-        /* Just a test, DO NOT leave this unchanged */
-        return 0;
-}
-
-irqreturn_t interrupt_handler(int irq_no, void *data)
-{
-	dprintk("[uart debug] interrupt_handler()\n");
-        int device_status;
-        uint32_t device_port;
-        /*
-         * TODO: Write the code that handles a hardware interrupt.
-         * TODO: Populate device_port with the port of the correct device.
-         */
-
-        device_status = uart16550_hw_get_device_status(device_port);
-
-        while (uart16550_hw_device_can_send(device_status)) {
-                uint8_t byte_value;
-                /*
-                 * TODO: Populate byte_value with the next value
-                 *      from the kernel device outgoing buffer.
-                 */
-                uart16550_hw_write_to_device(device_port, byte_value);
-                device_status = uart16550_hw_get_device_status(device_port);
-        }
-
-        while (uart16550_hw_device_has_data(device_status)) {
-                uint8_t byte_value;
-                byte_value = uart16550_hw_read_from_device(device_port);
-                /*
-                 * TODO: Store the read byte_value in the kernel device
-                 *      incoming buffer.
-                 */
-                device_status = uart16550_hw_get_device_status(device_port);
-        }
-
-        return IRQ_HANDLED;
+
+	if (ACCESS_ONCE(data->shared))
+		return -EBUSY;
+
+	if (file->f_flags & O_NONBLOCK) {
+		if (!mutex_trylock(&data->write_lock))
+			return -EAGAIN;
+		ret = !kfifo_is_full(&data->write_fifo) ? 0 : -EAGAIN;
+	} else {
+		if (mutex_lock_interruptible(&data->write_lock))
+			return -ERESTARTSYS;
+		/* Block until the interrupt handler has made room */
+		start = ktime_get();
+		ret = wait_event_interruptible(data->wq_writes,
+				!kfifo_is_full(&data->write_fifo) ||
+				ACCESS_ONCE(data->shared));
+		this_cpu_add(data->stats->write_wait_ns,
+				ktime_to_ns(ktime_sub(ktime_get(), start)));
+		if (!ret && ACCESS_ONCE(data->shared))
+			ret = -EBUSY;
+	}
+	if (!ret)
+		ret = kfifo_from_user(&data->write_fifo, user_buffer, size,
+				&bytes_copied);
+
+	mutex_unlock(&data->write_lock);
+
+	if (ret)
+		return ret;
+
+	kick_tx(data);
+
+	return bytes_copied;
+}
+
+/*
+ * Closes the observation window and, in adaptive mode, moves the RX
+ * trigger one level: down when most RX interrupts were character timeouts
+ * (bursts end below the trigger, every one of them pays the timeout), up
+ * when interrupts come fast and each already drains a full trigger level.
+ */
+static void adapt_trigger(struct device_data *data)
+{
+	unsigned long elapsed = jiffies - data->window.start;
+	unsigned int rx_irqs = data->window.rx_irqs;
+	int i = trigger_index(data->rx_trigger);
+
+	if (elapsed < ADAPT_WINDOW)
+		return;
+
+	data->window.irqs_per_sec = rx_irqs * HZ / elapsed;
+
+	if (data->adaptive && rx_irqs) {
+		if (data->window.rx_timeouts * 2 > rx_irqs) {
+			if (i > 0)
+				i--;
+		} else if (data->window.irqs_per_sec > ADAPT_IRQ_RATE &&
+				data->window.rx_bytes / rx_irqs >= data->rx_trigger) {
+			if (i < ARRAY_SIZE(trigger_levels) - 1)
+				i++;
+		}
+		if (trigger_levels[i] != data->rx_trigger) {
+			data->rx_trigger = trigger_levels[i];
+			uart16550_hw_set_rx_trigger(data->baseport,
+					data->rx_trigger);
+		}
+	}
+
+	data->window.start = jiffies;
+	data->window.rx_irqs = 0;
+	data->window.rx_timeouts = 0;
+	data->window.rx_bytes = 0;
+}
+
+/* Queues received bytes, counting those a full RX ring has to drop */
+static int store_rx(struct device_data *data, uint8_t *buf, int count)
+{
+	int stored = rx_ring_in(data, buf, count);
+
+	if (stored < count)
+		this_cpu_add(data->stats->rx_drops, count - stored);
+
+	/* Nearly full: ask the other end to stop before bytes get dropped */
+	if (data->line.flow == UART16550_FLOW_RTSCTS && !data->rx_throttled &&
+			rx_ring_len(data) >= FLOW_HIGH_WATERMARK) {
+		uart16550_hw_set_rts(data->baseport, 0);
+		data->rx_throttled = 1;
+	}
+	return stored;
+}
+
+/* Whether the other end lets us send, always without flow control */
+static int may_send(struct device_data *data)
+{
+	if (data->line.flow != UART16550_FLOW_RTSCTS)
+		return 1;
+	return uart16550_hw_clear_to_send(
+			uart16550_hw_get_modem_status(data->baseport));
+}
+
+/*
+ * Drains what is left in the RX FIFO with an LSR check per byte, then
+ * fills the whole TX FIFO in one burst if THRE is set. Returns whether
+ * LSR.DR read 0 at the end, i.e. the RX FIFO was left empty. Called with
+ * hw_lock held.
+ */
+static int transfer(struct device_data *data, int *received, int *sent)
+{
+	uint32_t device_port = data->baseport;
+	uint8_t burst[UART16550_FIFO_MAX];
+	int device_status, count = 0;
+
+	device_status = uart16550_hw_get_line_status(device_port);
+	while (uart16550_hw_device_has_data(device_status) &&
+			count < UART16550_HW_FIFO_DEPTH) {
+		if (uart16550_hw_device_overrun(device_status))
+			this_cpu_inc(data->stats->overruns);
+		burst[count++] = uart16550_hw_read_from_device(device_port);
+		device_status = uart16550_hw_get_line_status(device_port);
+	}
+	if (uart16550_hw_device_overrun(device_status))
+		this_cpu_inc(data->stats->overruns);
+	*received += store_rx(data, burst, count);
+
+	/*
+	 * THRE means the whole TX FIFO is empty: fill it in one go. While CTS
+	 * is down nothing is sent, the modem status interrupt of CTS coming
+	 * back brings us here again.
+	 */
+	if (uart16550_hw_device_can_send(device_status) &&
+			tx_ring_len(data) && may_send(data)) {
+		count = tx_ring_out(data, burst, UART16550_HW_FIFO_DEPTH);
+		uart16550_hw_write_burst(device_port, burst, count);
+		*sent += count;
+	}
+	return !uart16550_hw_device_has_data(device_status);
+}
+
+static void account(struct device_data *data, int received, int sent)
+{
+	this_cpu_add(data->stats->rx_bytes, received);
+	this_cpu_add(data->stats->tx_bytes, sent);
+
+	if (received)
+		set_bit(EVENT_RX, &data->events);
+	if (sent)
+		set_bit(EVENT_TX, &data->events);
+}
+
+/*
+ * Wakes readers only once rx_watermark bytes are buffered or the sender
+ * went quiet, and writers only once the TX ring is down to tx_watermark,
+ * instead of on every burst.
+ */
+static void wake_waiters(struct device_data *data)
+{
+	int burst_end;
+
+	/* Left pending until readers are woken, a later burst end does it */
+	if (test_bit(EVENT_RX, &data->events)) {
+		burst_end = test_and_clear_bit(EVENT_RX_BURST_END, &data->events);
+		if (burst_end || rx_ring_len(data) >= rx_watermark) {
+			clear_bit(EVENT_RX, &data->events);
+			if (waitqueue_active(&data->wq_reads))
+				this_cpu_inc(data->stats->rx_wakeups);
+			wake_up_interruptible(&data->wq_reads);
+			kill_fasync(&data->async_queue, SIGIO, POLL_IN);
+		}
+	}
+
+	if (test_bit(EVENT_TX, &data->events) &&
+			tx_ring_len(data) <= tx_watermark) {
+		clear_bit(EVENT_TX, &data->events);
+		if (waitqueue_active(&data->wq_writes))
+			this_cpu_inc(data->stats->tx_wakeups);
+		wake_up_interruptible(&data->wq_writes);
+		kill_fasync(&data->async_queue, SIGIO, POLL_OUT);
+	}
+}
+
+/*
+ * Services a port in polled mode, every poll_period_ns with interrupts
+ * off. Once the line has been idle for POLL_IDLE_LIMIT periods (or polled
+ * mode was turned off) interrupts are turned back on and the timer stops,
+ * until the next interrupt hands the port back.
+ */
+static enum hrtimer_restart poll_timer(struct hrtimer *timer)
+{
+	struct device_data *data = container_of(timer, struct device_data,
+			poll_timer);
+	enum hrtimer_restart restart = HRTIMER_RESTART;
+	int received = 0, sent = 0, drained;
+
+	spin_lock(&data->hw_lock);
+
+	drained = transfer(data, &received, &sent);
+	account(data, received, sent);
+	this_cpu_inc(data->stats->polls);
+
+	if (received || sent) {
+		/* Nothing left behind: no timeout would follow either */
+		if (received && drained)
+			set_bit(EVENT_RX_BURST_END, &data->events);
+		data->idle_polls = 0;
+	} else {
+		/* A poll without new bytes ends the burst */
+		set_bit(EVENT_RX_BURST_END, &data->events);
+		data->idle_polls++;
+	}
+
+	if (!data->polled || (data->idle_polls >= POLL_IDLE_LIMIT &&
+				!tx_ring_len(data))) {
+		data->polling = 0;
+		uart16550_hw_set_interrupts(data->baseport, data->ier);
+		restart = HRTIMER_NORESTART;
+	} else {
+		hrtimer_forward_now(timer, ns_to_ktime(data->poll_period_ns));
+	}
+
+	spin_unlock(&data->hw_lock);
+
+	wake_waiters(data);
+
+	return restart;
+}
+
+/*
+ * Hard half of a port's interrupt: only moves data between the hardware
+ * FIFOs and the kfifos, in bursts. The LSR is read once per burst instead
+ * of once per byte wherever the hardware already guarantees how many bytes
+ * are there (RDAI) or how much room is left (THRE). Waking up readers and
+ * writers is left to interrupt_thread.
+ */
+static irqreturn_t port_interrupt(struct device_data *data)
+{
+	uint32_t device_port = data->baseport;
+	uint8_t burst[UART16550_FIFO_DEPTH];
+	int interrupt_id;
+	int received = 0, sent = 0, drained;
+
+	spin_lock(&data->hw_lock);
+
+	interrupt_id = uart16550_hw_get_interrupt_id(device_port);
+	if (interrupt_id == UART16550_IID_NONE) {
+		/* Not asserting, another port on the line raised it */
+		spin_unlock(&data->hw_lock);
+		return IRQ_NONE;
+	}
+
+	do {
+		if (interrupt_id == UART16550_IID_RDAI) {
+			/* At least the trigger level is waiting in the FIFO */
+			uart16550_hw_read_burst(device_port, burst,
+					data->rx_trigger);
+			received += store_rx(data, burst, data->rx_trigger);
+			data->window.rx_irqs++;
+		} else if (interrupt_id == UART16550_IID_TIMEOUT) {
+			data->window.rx_irqs++;
+			data->window.rx_timeouts++;
+			set_bit(EVENT_RX_BURST_END, &data->events);
+		} else if (interrupt_id == UART16550_IID_MSI) {
+			/* CTS changed; acknowledge, transfer() checks it */
+			uart16550_hw_get_modem_status(device_port);
+		}
+
+		/* The rest (or a character timeout) needs a check per byte */
+		drained = transfer(data, &received, &sent);
+
+		interrupt_id = uart16550_hw_get_interrupt_id(device_port);
+	} while (interrupt_id != UART16550_IID_NONE);
+
+	data->window.rx_bytes += received;
+	adapt_trigger(data);
+
+	/*
+	 * No character timeout follows a FIFO drained down to empty (nor any
+	 * with a trigger of 1): the burst ends here, or readers would sleep on
+	 * whatever is below rx_watermark.
+	 */
+	if (received && (drained || data->rx_trigger == UART16550_TRIGGER_1))
+		set_bit(EVENT_RX_BURST_END, &data->events);
+	account(data, received, sent);
+	this_cpu_inc(data->stats->irqs);
+	this_cpu_inc(data->stats->rx_per_irq[min(received, HIST_BUCKETS - 1)]);
+
+	if (data->polled && (received || sent)) {
+		/* Traffic again: hand the port over to the poll timer */
+		uart16550_hw_disable_interrupts(device_port);
+		data->polling = 1;
+		data->idle_polls = 0;
+		hrtimer_start(&data->poll_timer,
+				ns_to_ktime(data->poll_period_ns),
+				HRTIMER_MODE_REL);
+	}
+
+	spin_unlock(&data->hw_lock);
+
+	return (received || sent) ? IRQ_WAKE_THREAD : IRQ_HANDLED;
+}
+
+/*
+ * One handler per IRQ line, for all the ports on it. Each pass reads the
+ * IIR of every port and services only those with an interrupt pending;
+ * passes repeat until none is, as a port may assert while another is
+ * being serviced and the ISA line is edge triggered.
+ */
+irqreturn_t interrupt_handler(int irq_no, void *dev_id)
+{
+	struct irq_group *group = dev_id;
+	struct device_data *data;
+	irqreturn_t ret = IRQ_NONE, port_ret;
+	int pass = 0, serviced;
+
+	do {
+		serviced = 0;
+		list_for_each_entry(data, &group->ports, irq_node) {
+			port_ret = port_interrupt(data);
+			if (port_ret == IRQ_NONE)
+				continue;
+			serviced = 1;
+			if (ret != IRQ_WAKE_THREAD)
+				ret = port_ret;
+		}
+	} while (serviced && ++pass < IRQ_PASS_LIMIT);
+
+	return ret;
+}
+
+/* Threaded half of the interrupt */
+static irqreturn_t interrupt_thread(int irq_no, void *dev_id)
+{
+	struct irq_group *group = dev_id;
+	struct device_data *data;
+
+	list_for_each_entry(data, &group->ports, irq_node)
+		wake_waiters(data);
+	return IRQ_HANDLED;
+}
+
+static int stats_show(struct seq_file *m, void *v)
+{
+	struct device_data *data = m->private;
+	struct port_stats stats;
+
+	sum_stats(data, &stats);
+	seq_printf(m, "rx_bytes %llu\n", stats.rx_bytes);
+	seq_printf(m, "tx_bytes %llu\n", stats.tx_bytes);
+	seq_printf(m, "irqs %llu\n", stats.irqs);
+	seq_printf(m, "polls %llu\n", stats.polls);
+	/* Bytes are moved by both, in polled mode mostly by the timer */
+	seq_printf(m, "bytes_per_service %llu\n", stats.irqs + stats.polls ?
+			div64_u64(stats.rx_bytes + stats.tx_bytes,
+				stats.irqs + stats.polls) : 0);
+	seq_printf(m, "overruns %llu\n", stats.overruns);
+	seq_printf(m, "rx_drops %llu\n", stats.rx_drops);
+	seq_printf(m, "rx_wakeups %llu\n", stats.rx_wakeups);
+	seq_printf(m, "tx_wakeups %llu\n", stats.tx_wakeups);
+	seq_printf(m, "read_wait_ns %llu\n", stats.read_wait_ns);
+	seq_printf(m, "write_wait_ns %llu\n", stats.write_wait_ns);
+	return 0;
+}
+
+/* One line per bucket: RX bytes drained by an interrupt, times seen */
+static int rx_per_irq_show(struct seq_file *m, void *v)
+{
+	struct device_data *data = m->private;
+	struct port_stats stats;
+	int i;
+
+	sum_stats(data, &stats);
+	for (i = 0; i < HIST_BUCKETS - 1; i++)
+		seq_printf(m, "%2d %llu\n", i, stats.rx_per_irq[i]);
+	seq_printf(m, "%2d+ %llu\n", i, stats.rx_per_irq[i]);
+	return 0;
+}
+
+static int stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, stats_show, inode->i_private);
+}
+
+static int rx_per_irq_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, rx_per_irq_show, inode->i_private);
+}
+
+static const struct file_operations stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static const struct file_operations rx_per_irq_fops = {
+	.owner		= THIS_MODULE,
+	.open		= rx_per_irq_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/* /sys/kernel/debug/uart16550/<name>/ */
+static void debugfs_add_port(struct device_data *data, const char *name)
+{
+	struct dentry *dir;
+
+	if (IS_ERR_OR_NULL(uart16550_debugfs))
+		return;
+	dir = debugfs_create_dir(name, uart16550_debugfs);
+	debugfs_create_file("stats", 0444, dir, data, &stats_fops);
+	debugfs_create_file("rx_per_irq", 0444, dir, data, &rx_per_irq_fops);
+}
+
+static unsigned int uart16550_poll(struct file *file, poll_table *wait)
+{
+	struct device_data *data = file->private_data;
+	unsigned int mask = 0;
+
+	poll_wait(file, &data->wq_reads, wait);
+	poll_wait(file, &data->wq_writes, wait);
+
+	if (ACCESS_ONCE(data->shared)) {
+		/* Where an mmap() consumer blocks, having drained the ring */
+		rx_unthrottle(data);
+		if (rx_ring_len(data))
+			mask |= POLLIN | POLLRDNORM;
+		if (tx_ring_len(data) < SHARED_RING_SIZE)
+			mask |= POLLOUT | POLLWRNORM;
+		return mask;
+	}
+
+	if (!kfifo_is_empty(&data->read_fifo))
+		mask |= POLLIN | POLLRDNORM;
+	if (!kfifo_is_full(&data->write_fifo))
+		mask |= POLLOUT | POLLWRNORM;
+
+	return mask;
+}
+
+/*
+ * The first mapping switches the interrupt path over to the shared rings,
+ * the last unmap switches it back to the kfifos. Bytes still in the kfifos
+ * stay there until then.
+ */
+static void shared_vm_open(struct vm_area_struct *vma)
+{
+	struct device_data *data = vma->vm_private_data;
+	struct uart16550_mmap_header *header = data->shared_area;
+	unsigned long flags;
+
+	mutex_lock(&data->mmap_lock);
+	if (!data->mappings++) {
+		spin_lock_irqsave(&data->hw_lock, flags);
+		memset(header, 0, sizeof(*header));
+		header->rx.size = SHARED_RING_SIZE;
+		header->rx.offset = SHARED_RX_OFFSET;
+		header->tx.size = SHARED_RING_SIZE;
+		header->tx.offset = SHARED_TX_OFFSET;
+		data->rx_head = 0;
+		data->tx_tail = 0;
+		data->shared = header;
+		spin_unlock_irqrestore(&data->hw_lock, flags);
+		/* Blocked in read() or write(): they get -EBUSY now */
+		wake_up_interruptible(&data->wq_reads);
+		wake_up_interruptible(&data->wq_writes);
+	}
+	mutex_unlock(&data->mmap_lock);
+}
+
+static void shared_vm_close(struct vm_area_struct *vma)
+{
+	struct device_data *data = vma->vm_private_data;
+	unsigned long flags;
+
+	mutex_lock(&data->mmap_lock);
+	if (!--data->mappings) {
+		spin_lock_irqsave(&data->hw_lock, flags);
+		data->shared = NULL;
+		spin_unlock_irqrestore(&data->hw_lock, flags);
+		/* The kfifos may have been drained since */
+		rx_unthrottle(data);
+	}
+	mutex_unlock(&data->mmap_lock);
+}
+
+static const struct vm_operations_struct shared_vm_ops = {
+	.open	= shared_vm_open,
+	.close	= shared_vm_close,
+};
+
+/* Maps the header page and both rings, all at once and from offset 0 */
+static int uart16550_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct device_data *data = file->private_data;
+	int ret;
+
+	if (vma->vm_pgoff || vma->vm_end - vma->vm_start != SHARED_AREA_SIZE)
+		return -EINVAL;
+	/* A private copy would hide head and tail updates from the driver */
+	if (!(vma->vm_flags & VM_SHARED))
+		return -EINVAL;
+	vma->vm_flags &= ~VM_MAYEXEC;
+
+	/* Kept until the module goes away, in case of a late interrupt */
+	mutex_lock(&data->mmap_lock);
+	if (!data->shared_area)
+		data->shared_area = vmalloc_user(SHARED_AREA_SIZE);
+	mutex_unlock(&data->mmap_lock);
+	if (!data->shared_area)
+		return -ENOMEM;
+
+	ret = remap_vmalloc_range(vma, data->shared_area, 0);
+	if (ret)
+		return ret;
+	vma->vm_private_data = data;
+	vma->vm_ops = &shared_vm_ops;
+	shared_vm_open(vma);
+	return 0;
 }
 
 /* See: http://www.tldp.org/LDP/lkmpg/2.4/html/c577.htm */
@@ -153,198 +1092,267 @@ static const struct file_operations uart_fops =
 	.release= uart16550_release,
 	.write	= uart16550_write,
 	.read	= uart16550_read,
+	.poll	= uart16550_poll,
+	.mmap	= uart16550_mmap,
+	.fasync	= uart16550_fasync,
 	.unlocked_ioctl	= uart16550_ioctl
 };
 
-/* Makes sure the given parameters are legal */
+/*
+ * Makes sure the given parameters are legal. A baseport of 0 is also the
+ * emulator's free slot, and all the port's registers must fit in I/O space.
+ */
 static int bad_parameters(int major, int behavior) {
+	int i;
+
+	if (nr_baseports) {
+		if ((major < 0) || (major > 1000000) ||
+				(nr_irq_params != nr_baseports))
+			return 1;
+		for (i = 0; i < nr_baseports; i++) {
+			if (baseports[i] <= 0 ||
+					baseports[i] > 0x10000 - NR_IO_PORTS)
+				return 1;
+			if (irqs[i] < 0 || irqs[i] >= NR_IRQS)
+				return 1;
+		}
+		return 0;
+	}
 	return (major < 0) || (major > 1000000) || (behavior < 0x1) || (behavior > 0x3);
 }
 
-static void uart16550_cleanup(void)
+/* NUMA node the IRQ is delivered to, where its ports' data should live */
+static int irq_node(int irq)
 {
-	
-	dprintk("[uart debug] iuart16550_cleanup()\n");
-	
-	if (bad_parameters(major, behavior)) {
-		goto cleanup_done;
+	struct irq_data *irq_data = irq_get_irq_data(irq);
+
+	return irq_data ? irq_data->node : NUMA_NO_NODE;
+}
+
+static struct irq_group *irq_group_get(int irq)
+{
+	struct irq_group *group;
+
+	list_for_each_entry(group, &irq_groups, node)
+		if (group->irq == irq)
+			return group;
+
+	group = kzalloc_node(sizeof(*group), GFP_KERNEL, irq_node(irq));
+	if (!group)
+		return NULL;
+	group->irq = irq;
+	INIT_LIST_HEAD(&group->ports);
+	list_add_tail(&group->node, &irq_groups);
+	return group;
+}
+
+/* Allocates a port on its IRQ's node and links it into the IRQ's group */
+static struct device_data *port_alloc(int baseport, int irq, int minor)
+{
+	struct irq_group *group = irq_group_get(irq);
+	struct device_data *data;
+
+	if (!group)
+		return NULL;
+	data = kzalloc_node(sizeof(*data), GFP_KERNEL, irq_node(irq));
+	if (!data)
+		return NULL;
+
+	data->baseport = baseport;
+	data->irq = irq;
+	data->minor = minor;
+	INIT_KFIFO(data->read_fifo);
+	INIT_KFIFO(data->write_fifo);
+	mutex_init(&data->read_lock);
+	mutex_init(&data->write_lock);
+	init_waitqueue_head(&data->wq_reads);
+	init_waitqueue_head(&data->wq_writes);
+	mutex_init(&data->mmap_lock);
+	data->line = (struct uart16550_line_info) UART16550_DEFAULT_LINE;
+	data->rx_trigger = UART16550_RX_TRIGGER;
+	data->ier = UART16550_IER_RDAI | UART16550_IER_THREI;
+	data->window.start = jiffies;
+	spin_lock_init(&data->hw_lock);
+	data->polled = polled;
+	data->poll_period_ns = poll_period(data->line);
+	hrtimer_init(&data->poll_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	data->poll_timer.function = poll_timer;
+	data->stats = alloc_percpu(struct port_stats);
+	if (!data->stats) {
+		kfree(data);
+		return NULL;
 	}
-	
-        int have_com1 = 0;
-        int have_com2 = 0;
-        
-        /*
-         * TODO: Write driver cleanup code here.
-         * TODO: have_com1 & have_com2 need to be set according to the
-         *      module parameters.
-         */
-         
-        /* UART16550_COM1_SELECTED is 0x1 */
-	have_com1 = behavior & UART16550_COM1_SELECTED;
-	
-	/* UART16550_COM2_SELECTED is 0x2 */
-	have_com2 = behavior & UART16550_COM2_SELECTED;
-         
-        if (have_com1) {
-                /* Reset the hardware device for COM1 */
-                uart16550_hw_cleanup_device(COM1_BASEPORT);
-		/* Unregister character device */
-		dev_t dev_no = MKDEV(major, 0);
+
+	list_add_tail(&data->irq_node, &group->ports);
+	return data;
+}
+
+/* Brings the hardware up and makes /dev/comN appear, IRQs already requested */
+static int port_start(struct device_data *data)
+{
+	dev_t dev_no = MKDEV(major, data->minor);
+	char name[16];
+
+	snprintf(name, sizeof(name), "com%d", data->minor + 1);
+
+	/* Setup the hardware device */
+	if (uart16550_hw_setup_device(data->baseport, data->irq,
+				THIS_MODULE->name)) {
+		dprintk("[uart debug] An error occured on uart16550_hw_setup_device (%s)\n", name);
+		return -ENODEV;
+	}
+	data->have_hw = 1;
+
+	/* Register character device */
+	if (register_chrdev_region(dev_no, 1, MODULE_NAME)) {
+		dprintk("[uart debug] An error occured on register_chrdev_region (%s)\n", name);
+		return -EBUSY;
+	}
+
+	/* The cdev is embedded so open() can find the device_data */
+	cdev_init(&data->cdev, &uart_fops);
+	data->cdev.owner = THIS_MODULE;
+
+	/* Note: after calling cdev_add, the device is "live" and
+	*  its operations can be called by the kernel */
+	if (cdev_add(&data->cdev, dev_no, 1)) {
+		printk ("[uart debug] cdev_add() failed (%s)\n", name);
 		unregister_chrdev_region(dev_no, 1);
-                /* Remove the sysfs info for /dev/com1 */
-                device_destroy(uart16550_class, dev_no);
-                /* Deallocate struct */
-                cdev_del(uart_cdev_com1);
-        }
-        if (have_com2) {
-                /* Reset the hardware device for COM2 */
-                uart16550_hw_cleanup_device(COM2_BASEPORT);
+		return -EBUSY;
+	}
+	data->have_cdev = 1;
+
+	/* Create the sysfs info for /dev/comN */
+	device_create(uart16550_class, NULL, dev_no, NULL, name);
+	debugfs_add_port(data, name);
+
+	return 0;
+}
+
+static void port_stop(struct device_data *data)
+{
+	dev_t dev_no = MKDEV(major, data->minor);
+
+	if (data->have_cdev) {
+		/* Remove the sysfs info for /dev/comN */
+		device_destroy(uart16550_class, dev_no);
+		cdev_del(&data->cdev);
 		/* Unregister character device */
-		dev_t dev_no = MKDEV(major, 1);
 		unregister_chrdev_region(dev_no, 1);
-                /* Remove the sysfs info for /dev/com2 */
-                device_destroy(uart16550_class, dev_no);
-                /* Deallocate struct */
-                cdev_del(uart_cdev_com2);
-        }
+	}
+
+	/* Stop polling, the timer would turn interrupts back on */
+	data->polled = 0;
+	hrtimer_cancel(&data->poll_timer);
+	if (data->have_hw) {
+		/* Reset the hardware device */
+		uart16550_hw_cleanup_device(data->baseport);
+	}
+}
+
+static void uart16550_cleanup(void)
+{
+	struct irq_group *group, *next;
+	int i;
+
+	dprintk("[uart debug] iuart16550_cleanup()\n");
 
-        /*
-         * Cleanup the sysfs device class.
-         */
-        class_unregister(uart16550_class);
-        class_destroy(uart16550_class);
-        
-        cleanup_done: /* Nothing */ ;
+	/* Remove the statistics files before the counters go away */
+	debugfs_remove_recursive(uart16550_debugfs);
+
+	for (i = 0; i < nr_devs; i++)
+		port_stop(devs[i]);
+
+	list_for_each_entry_safe(group, next, &irq_groups, node) {
+		if (group->requested)
+			uart16550_hw_free_irq(group->irq, group);
+		list_del(&group->node);
+		kfree(group);
+	}
+
+	for (i = 0; i < nr_devs; i++) {
+		free_percpu(devs[i]->stats);
+		vfree(devs[i]->shared_area);
+		kfree(devs[i]);
+	}
+	nr_devs = 0;
+
+	/*
+	 * Cleanup the sysfs device class.
+	 */
+	if (!IS_ERR_OR_NULL(uart16550_class)) {
+		class_unregister(uart16550_class);
+		class_destroy(uart16550_class);
+	}
 }
 
 static int uart16550_init(void)
 {
+	int minors[MAX_NUMBER_DEVICES];
+	struct irq_group *group;
+	int i;
+
 	dprintk("[uart debug] In uart16550_init() called with major=%d behavior=%#03x\n", major, behavior);
-	
-        int have_com1 = 0;
-        int have_com2 = 0;
-        /*
-         * TODO: Write driver initialization code here.
-         * TODO: have_com1 & have_com2 need to be set according to the
-         *      module parameters.
-         * TODO: Check return values of functions used. Fail gracefully.
-         */
 
 	if (bad_parameters(major, behavior)) {
 		/* Invalid parameters */
 		dprintk("[uart debug] Invalid parameters\n");
-		goto fail_init;
+		return -EINVAL;
 	}
-	
-	/* UART16550_COM1_SELECTED is 0x1 */
-	have_com1 = behavior & UART16550_COM1_SELECTED;
-	
-	/* UART16550_COM2_SELECTED is 0x2 */
-	have_com2 = behavior & UART16550_COM2_SELECTED;
-	
 
-        /*
-         * Setup a sysfs class & device to make /dev/com1 & /dev/com2 appear.
-         */
-        uart16550_class = class_create(THIS_MODULE, "uart16550");
-
-        if (have_com1) {
-        	dprintk("[uart debug] have_com1 = true\n");
-        	
-        	devs[0].baseport = COM1_BASEPORT;
-		init_waitqueue_head(&devs[0].wq_reads);
-		init_waitqueue_head(&devs[0].wq_writes);
-		if (request_irq(COM1_IRQ, irq_handle, IRQF_SHARED, MODULE_NAME, &devs[0])) {
-			dprintk("[uart debug] request_irq() failed (com1)\n");
-			goto fail_init;;
-		}
-		/*enable interrupts*/
-		outb(0x08, COM2_BASEPORT + 4);
-		outb(0x03, COM2_BASEPORT + 1);
-        	
-                /* Setup the hardware device for COM1 */
-                if (uart16550_hw_setup_device(COM1_BASEPORT, THIS_MODULE->name)) {
-                	dprintk("[uart debug] An error occured on uart16550_hw_setup_device (com1)\n");
-                	goto fail_init;
-                }
-                
-                /* Register character device */
-		dev_t dev_no = MKDEV(major, 0);
-		if (register_chrdev_region(dev_no, 1, MODULE_NAME)) {
-			dprintk("[uart debug] An error occured on register_chrdev_region (com1)\n");
-			goto fail_init;
-		}
-		
-		/* Create the sysfs info for /dev/com1 */
-                device_create(uart16550_class, NULL, dev_no, NULL, "com1");
-                
-                /* cdev thing */
-                uart_cdev_com1 = cdev_alloc();
-		if (NULL == uart_cdev_com1) {
-			/* Allocation failed */
-			dprintk("[uart debug] cdev_alloc() failed  (com1)\n");
-			goto fail_init;
-		}
-		uart_cdev_com1->ops = &uart_fops;
-		
-		/* Note: after calling cdev_add, the device is "live" and
-		*  its operations can be called by the kernel */
-		if (cdev_add(uart_cdev_com1, dev_no, 1)) {
-			printk ("[uart debug] cdev_add() failed (com1)\n");
-			goto fail_init;
+	for (i = 0; i < nr_baseports; i++)
+		minors[i] = i;
+
+	/* Without a port list, behavior selects COM1 and/or COM2 */
+	if (!nr_baseports) {
+		if (behavior & UART16550_COM1_SELECTED) {
+			baseports[nr_baseports] = COM1_BASEPORT;
+			irqs[nr_baseports] = COM1_IRQ;
+			minors[nr_baseports++] = 0;
 		}
-        }
-        if (have_com2) {
-        	dprintk("[uart debug] have_com2 = true\n");
-        	
-        	devs[1].baseport = COM2_BASEPORT;
-		init_waitqueue_head(&devs[1].wq_reads);
-		init_waitqueue_head(&devs[1].wq_writes);
-		if (request_irq(COM2_IRQ, irq_handle, IRQF_SHARED, MODULE_NAME, &devs[1])) {
-			dprintk("[uart debug] request_irq() failed (com2)\n");
-			goto fail_init;
+		if (behavior & UART16550_COM2_SELECTED) {
+			baseports[nr_baseports] = COM2_BASEPORT;
+			irqs[nr_baseports] = COM2_IRQ;
+			minors[nr_baseports++] = 1;
 		}
-		/*enable interrupts*/
-		outb(0x08, COM2_BASEPORT + 4);
-		outb(0x03, COM2_BASEPORT + 1);
-        	
-                /* Setup the hardware device for COM2 */
-                
-                if (uart16550_hw_setup_device(COM2_BASEPORT, THIS_MODULE->name)) {
-                	dprintk("[uart debug] An error occured on uart16550_hw_setup_device (com2)\n");
-                	goto fail_init;
-                }
-                
-		/* Register character device */
-		dev_t dev_no = MKDEV(major, 1);
-		
-		if (register_chrdev_region(dev_no, 1, MODULE_NAME)) {
-			dprintk("[uart debug] An error occured on register_chrdev_region (com2)\n");
+	}
+
+	/*
+	 * Setup a sysfs class & device to make /dev/comN appear.
+	 */
+	uart16550_class = class_create(THIS_MODULE, "uart16550");
+
+	/* Statistics under /sys/kernel/debug/uart16550/, optional */
+	uart16550_debugfs = debugfs_create_dir(MODULE_NAME, NULL);
+
+	for (i = 0; i < nr_baseports; i++) {
+		devs[nr_devs] = port_alloc(baseports[i], irqs[i], minors[i]);
+		if (!devs[nr_devs]) {
+			dprintk("[uart debug] port_alloc() failed (%#x)\n", baseports[i]);
 			goto fail_init;
 		}
-		
-                /* Create the sysfs info for /dev/com2 */
-                device_create(uart16550_class, NULL, dev_no, NULL, "com2");
-                
-                /* cdev thing */
-                uart_cdev_com2 = cdev_alloc();
-		if (NULL == uart_cdev_com2) {
-			/* Allocation failed */
-			dprintk("[uart debug] cdev_alloc() failed  (com2)\n");
+		nr_devs++;
+	}
+
+	/* Every group is complete, its handler may run from now on */
+	list_for_each_entry(group, &irq_groups, node) {
+		if (uart16550_hw_request_irq(group->irq, interrupt_handler,
+					interrupt_thread, MODULE_NAME, group)) {
+			dprintk("[uart debug] uart16550_hw_request_irq() failed (irq %d)\n", group->irq);
 			goto fail_init;
 		}
-		uart_cdev_com2->ops = &uart_fops;
-		
-		if (cdev_add(uart_cdev_com2, dev_no, 1)) {
-			printk ("[uart debug] cdev_add() failed (com2)\n");
+		group->requested = 1;
+	}
+
+	for (i = 0; i < nr_devs; i++)
+		if (port_start(devs[i]))
 			goto fail_init;
-		}
-        }
-        return 0;
-        
-        fail_init:
-        	uart16550_cleanup();
-        	return -1;
+
+	return 0;
+
+fail_init:
+	uart16550_cleanup();
+	return -1;
 }
 
 module_init(uart16550_init)
@@ -8,14 +8,68 @@
 #define UART16550_COM1_SELECTED         0x01
 #define UART16550_COM2_SELECTED         0x02
 
-#define MAX_NUMBER_DEVICES              2
+#define MAX_NUMBER_DEVICES              32
 
 #define UART16550_IOCTL_SET_LINE        1
+#define UART16550_IOCTL_SET_TRIGGER     2
+#define UART16550_IOCTL_GET_TRIGGER     3
+#define UART16550_IOCTL_GET_WAKEUPS     4
+#define UART16550_IOCTL_SET_POLLED      5
+#define UART16550_IOCTL_MMAP_KICK       6
 
 struct uart16550_line_info {
         unsigned char baud, len, par, stop;
+        unsigned char flow;
 };
 
+/* Flow control, the flow field of struct uart16550_line_info */
+#define UART16550_FLOW_NONE             0
+#define UART16550_FLOW_RTSCTS           1
+
+/* RX FIFO trigger levels, the argument of UART16550_IOCTL_SET_TRIGGER */
+#define UART16550_TRIGGER_ADAPTIVE      0
+#define UART16550_TRIGGER_1             1
+#define UART16550_TRIGGER_4             4
+#define UART16550_TRIGGER_8             8
+#define UART16550_TRIGGER_14            14
+
+/* Filled in by UART16550_IOCTL_GET_TRIGGER */
+struct uart16550_trigger_info {
+        unsigned int level;             /* Current RX trigger level */
+        unsigned int adaptive;
+        unsigned int irqs_per_sec;      /* RX interrupts, last window */
+        unsigned int latency_ns;        /* Time to fill the trigger level */
+};
+
+/* Filled in by UART16550_IOCTL_GET_WAKEUPS, totals since module load */
+struct uart16550_wakeup_info {
+        unsigned long rx_bytes, tx_bytes;
+        unsigned long rx_wakeups, tx_wakeups;
+};
+
+/*
+ * mmap() of /dev/comN: a header page holding the indices of both rings,
+ * then the RX ring, then the TX ring, each FIFO_SIZE bytes rounded up to
+ * a page. Indices run freely and are taken modulo size. The producer only
+ * writes head, the consumer only writes tail. After filling the TX ring,
+ * UART16550_IOCTL_MMAP_KICK has the driver start sending.
+ */
+struct uart16550_ring {
+        unsigned int head;              /* Next byte the producer writes */
+        unsigned int tail;              /* Next byte the consumer reads */
+        unsigned int size;
+        unsigned int offset;            /* Of the data, from the mapping */
+} __attribute__((aligned(64)));
+
+struct uart16550_mmap_header {
+        struct uart16550_ring rx;       /* Driver produces, user consumes */
+        struct uart16550_ring tx;       /* User produces, driver consumes */
+};
+
+#define UART16550_MMAP_RING_SIZE(page)  \
+        ((FIFO_SIZE + (page) - 1) / (page) * (page))
+#define UART16550_MMAP_SIZE(page)       \
+        ((page) + 2 * UART16550_MMAP_RING_SIZE(page))
 
 #define COM1_BASEPORT                   0x3f8
 #define COM2_BASEPORT                   0x2f8
@@ -0,0 +1,465 @@
+#ifndef _UART16550_EMU
+#define _UART16550_EMU
+
+/*
+ * In-memory loopback 16550, for running the driver without COM ports.
+ * Built in with `make EMULATED=1`, in place of the I/O port accessors of
+ * uart16550_hw.h.
+ *
+ * Every character written to THR is shifted back into the RBR of the same
+ * port at the line rate set by emu_clock and the divisor latch. A
+ * character that finds the RX FIFO full is lost and raises LSR OE.
+ * Interrupts are raised from a per-port hrtimer by calling the handler
+ * registered through uart16550_hw_request_irq for the port's IRQ line,
+ * and its threaded half is run from a work item. Ports sharing a line
+ * never run its handler concurrently, as with a real IRQ. MSR follows MCR
+ * as if RTS/DTR were wired back to CTS/DSR.
+ */
+
+#include <linux/hrtimer.h>
+#include <linux/workqueue.h>
+#include <linux/spinlock.h>
+#include <linux/kfifo.h>
+#include <linux/module.h>
+#include <linux/math64.h>
+
+#define EMU_MAX_PORTS           MAX_NUMBER_DEVICES
+#define EMU_FIFO_MIN            16
+#define EMU_FIFO_MAX            256
+/* Shortest timer period, several characters are moved per tick below it */
+#define EMU_MIN_TICK_NS         20000
+
+/* Input clock of the baud rate generator, divided by DLL/DLM */
+static unsigned int emu_clock = 115200;
+module_param(emu_clock, uint, 0444);
+
+/*
+ * Depth of the emulated hardware FIFOs, clamped to EMU_FIFO_MIN..MAX. The
+ * driver honours it: THRE bursts and RX drains move up to this many bytes.
+ */
+static unsigned int emu_fifo_depth = 16;
+module_param(emu_fifo_depth, uint, 0444);
+
+/* Characters lost to a full RX FIFO, on all ports */
+static unsigned int emu_overruns;
+module_param(emu_overruns, uint, 0444);
+
+#define UART16550_CLOCK         emu_clock
+#define UART16550_HW_FIFO_DEPTH emu_fifo_depth
+#define UART16550_FIFO_MAX      EMU_FIFO_MAX
+
+struct emu_port {
+        uint32_t base;
+        spinlock_t lock;
+        uint8_t ier, lcr, mcr, fcr, scr, dll, dlm;
+        uint8_t lsr_errors;             /* Cleared when LSR is read */
+        uint8_t msr_deltas;             /* Cleared when MSR is read */
+        int thre_pending;               /* Cleared by IIR read or THR write */
+        unsigned int idle_chars;        /* Character times without RX */
+        DECLARE_KFIFO(rx, uint8_t, EMU_FIFO_MAX);
+        DECLARE_KFIFO(tx, uint8_t, EMU_FIFO_MAX);
+        struct hrtimer timer;
+        int running;
+        ktime_t last_tick;
+        u64 credit_ns;                  /* Line time not spent yet */
+        int irq;
+};
+
+/* An IRQ line and the handler registered on it */
+struct emu_line {
+        int irq;
+        spinlock_t lock;                /* Held while the handler runs */
+        irq_handler_t handler, thread;
+        void *dev_id;
+        struct work_struct thread_work;
+};
+
+static struct emu_port emu_ports[EMU_MAX_PORTS];
+static struct emu_line emu_lines[EMU_MAX_PORTS];
+static DEFINE_SPINLOCK(emu_ports_lock);
+
+static struct emu_line *emu_line_find(int irq)
+{
+        int i;
+
+        for (i = 0; i < EMU_MAX_PORTS; i++)
+                if (ACCESS_ONCE(emu_lines[i].handler) &&
+                                emu_lines[i].irq == irq)
+                        return &emu_lines[i];
+        return NULL;
+}
+
+static struct emu_port *emu_port_find(uint32_t base)
+{
+        int i;
+
+        for (i = 0; i < EMU_MAX_PORTS; i++)
+                if (ACCESS_ONCE(emu_ports[i].base) == base)
+                        return &emu_ports[i];
+        return NULL;
+}
+
+static u64 emu_char_ns(struct emu_port *p)
+{
+        unsigned int bits = 1 + 5 + (p->lcr & 0x03) +
+                ((p->lcr & 0x08) ? 1 : 0) + ((p->lcr & 0x04) ? 2 : 1);
+        unsigned int divisor = p->dll | (p->dlm << 8);
+
+        return div_u64((u64)bits * (divisor ? divisor : 1) * NSEC_PER_SEC,
+                        emu_clock);
+}
+
+static u64 emu_tick_ns(struct emu_port *p)
+{
+        return max_t(u64, emu_char_ns(p), EMU_MIN_TICK_NS);
+}
+
+static unsigned int emu_rx_trigger(struct emu_port *p)
+{
+        static const unsigned int levels[] = { 1, 4, 8, 14 };
+
+        return levels[p->fcr >> 6];
+}
+
+/* IIR as the hardware computes it, highest priority source first */
+static uint8_t emu_iir(struct emu_port *p)
+{
+        uint8_t fifo_bits = (p->fcr & 0x01) ? 0xc0 : 0x00;
+        unsigned int rx_len = kfifo_len(&p->rx);
+
+        if ((p->ier & 0x04) && p->lsr_errors)
+                return fifo_bits | 0x06;
+        if ((p->ier & 0x01) && rx_len >= emu_rx_trigger(p))
+                return fifo_bits | 0x04;
+        if ((p->ier & 0x01) && rx_len && p->idle_chars >= 4)
+                return fifo_bits | 0x0c;
+        if ((p->ier & 0x02) && p->thre_pending)
+                return fifo_bits | 0x02;
+        if ((p->ier & 0x08) && p->msr_deltas)
+                return fifo_bits | 0x00;
+        return fifo_bits | 0x01;
+}
+
+static uint8_t emu_lsr(struct emu_port *p)
+{
+        uint8_t lsr = p->lsr_errors;
+
+        if (!kfifo_is_empty(&p->rx))
+                lsr |= 0x01;
+        if (kfifo_is_empty(&p->tx))
+                lsr |= 0x60;
+        return lsr;
+}
+
+/* Interrupt line asserted: OUT2 gates it, as on PC serial ports */
+static int emu_irq_pending(struct emu_port *p)
+{
+        return (p->mcr & 0x08) && !(emu_iir(p) & 0x01);
+}
+
+/* Called with p->lock held */
+static void emu_start(struct emu_port *p)
+{
+        if (p->running)
+                return;
+        p->running = 1;
+        p->last_tick = ktime_get();
+        p->credit_ns = 0;
+        hrtimer_start(&p->timer, ns_to_ktime(emu_tick_ns(p)),
+                        HRTIMER_MODE_REL);
+}
+
+static void emu_thread_work(struct work_struct *work)
+{
+        struct emu_line *line = container_of(work, struct emu_line,
+                        thread_work);
+
+        if (line->thread)
+                line->thread(line->irq, line->dev_id);
+}
+
+/* Runs the line's handler, and schedules its threaded half if asked to */
+static void emu_raise(int irq)
+{
+        struct emu_line *line = emu_line_find(irq);
+        irqreturn_t ret = IRQ_NONE;
+
+        if (!line)
+                return;
+        spin_lock(&line->lock);
+        if (line->handler)
+                ret = line->handler(irq, line->dev_id);
+        spin_unlock(&line->lock);
+        if (ret == IRQ_WAKE_THREAD && line->thread)
+                schedule_work(&line->thread_work);
+}
+
+/* Shifts the characters the elapsed line time allows, then raises the IRQ */
+static enum hrtimer_restart emu_tick(struct hrtimer *timer)
+{
+        struct emu_port *p = container_of(timer, struct emu_port, timer);
+        ktime_t now = ktime_get();
+        u64 char_ns;
+        uint8_t byte;
+        int pending;
+
+        spin_lock(&p->lock);
+
+        char_ns = emu_char_ns(p);
+        p->credit_ns += ktime_to_ns(ktime_sub(now, p->last_tick));
+        p->last_tick = now;
+
+        while (p->credit_ns >= char_ns) {
+                if (!kfifo_get(&p->tx, &byte)) {
+                        /* Line silent for the rest of the credit */
+                        p->idle_chars += div64_u64(p->credit_ns, char_ns);
+                        p->idle_chars = min(p->idle_chars, 4U);
+                        p->credit_ns = 0;
+                        break;
+                }
+                p->credit_ns -= char_ns;
+                if (kfifo_len(&p->rx) >= emu_fifo_depth) {
+                        p->lsr_errors |= 0x02;
+                        emu_overruns++;
+                } else {
+                        kfifo_put(&p->rx, byte);
+                }
+                p->idle_chars = 0;
+                if (kfifo_is_empty(&p->tx))
+                        p->thre_pending = 1;
+        }
+
+        pending = emu_irq_pending(p);
+
+        spin_unlock(&p->lock);
+
+        if (pending)
+                emu_raise(p->irq);
+
+        spin_lock(&p->lock);
+        /* Keep ticking while characters move or an interrupt is owed */
+        if (kfifo_is_empty(&p->tx) && !emu_irq_pending(p) &&
+                        (kfifo_is_empty(&p->rx) || p->idle_chars >= 4)) {
+                p->running = 0;
+                spin_unlock(&p->lock);
+                return HRTIMER_NORESTART;
+        }
+        spin_unlock(&p->lock);
+
+        hrtimer_forward_now(timer, ns_to_ktime(emu_tick_ns(p)));
+        return HRTIMER_RESTART;
+}
+
+static struct emu_port *emu_port_get(uint32_t base, int irq)
+{
+        struct emu_port *p;
+        int i;
+
+        spin_lock(&emu_ports_lock);
+        emu_fifo_depth = clamp_t(unsigned int, emu_fifo_depth,
+                        EMU_FIFO_MIN, EMU_FIFO_MAX);
+        p = emu_port_find(base);
+        for (i = 0; !p && i < EMU_MAX_PORTS; i++) {
+                if (emu_ports[i].base)
+                        continue;
+                p = &emu_ports[i];
+                memset(p, 0, sizeof(*p));
+                spin_lock_init(&p->lock);
+                INIT_KFIFO(p->rx);
+                INIT_KFIFO(p->tx);
+                hrtimer_init(&p->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+                p->timer.function = emu_tick;
+                p->irq = irq;
+                p->base = base;
+        }
+        spin_unlock(&emu_ports_lock);
+
+        return p;
+}
+
+static void emu_port_put(uint32_t base)
+{
+        struct emu_port *p = emu_port_find(base);
+
+        if (!p)
+                return;
+        hrtimer_cancel(&p->timer);
+        ACCESS_ONCE(p->base) = 0;
+}
+
+static uint8_t emu_read(uint32_t addr)
+{
+        struct emu_port *p = emu_port_find(addr & ~(NR_IO_PORTS - 1));
+        unsigned long flags;
+        uint8_t value = 0xff;
+        int dlab;
+
+        if (!p)
+                return value;
+
+        spin_lock_irqsave(&p->lock, flags);
+        dlab = p->lcr & 0x80;
+        switch (addr & (NR_IO_PORTS - 1)) {
+        case RBR:
+                if (dlab) {
+                        value = p->dll;
+                } else if (kfifo_get(&p->rx, &value)) {
+                        p->idle_chars = 0;
+                }
+                break;
+        case IER:
+                value = dlab ? p->dlm : p->ier;
+                break;
+        case ISR:
+                value = emu_iir(p);
+                if ((value & 0x0f) == 0x02)
+                        p->thre_pending = 0;
+                break;
+        case LCR:
+                value = p->lcr;
+                break;
+        case MCR:
+                value = p->mcr;
+                break;
+        case LSR:
+                value = emu_lsr(p);
+                p->lsr_errors = 0;
+                break;
+        case MSR:
+                /* RTS looped to CTS, DTR to DSR, carrier always present */
+                value = 0x80 | ((p->mcr & 0x02) ? 0x10 : 0) |
+                        ((p->mcr & 0x01) ? 0x20 : 0) | p->msr_deltas;
+                p->msr_deltas = 0;
+                break;
+        case SCR:
+                value = p->scr;
+                break;
+        }
+        spin_unlock_irqrestore(&p->lock, flags);
+
+        return value;
+}
+
+static void emu_write(uint8_t value, uint32_t addr)
+{
+        struct emu_port *p = emu_port_find(addr & ~(NR_IO_PORTS - 1));
+        unsigned long flags;
+        int dlab;
+
+        if (!p)
+                return;
+
+        spin_lock_irqsave(&p->lock, flags);
+        dlab = p->lcr & 0x80;
+        switch (addr & (NR_IO_PORTS - 1)) {
+        case THR:
+                if (dlab) {
+                        p->dll = value;
+                        break;
+                }
+                /* Writes to a full TX FIFO are lost, as on the hardware */
+                if (kfifo_len(&p->tx) < emu_fifo_depth)
+                        kfifo_put(&p->tx, value);
+                p->thre_pending = 0;
+                emu_start(p);
+                break;
+        case IER:
+                if (dlab) {
+                        p->dlm = value;
+                        break;
+                }
+                /* Enabling THREI with THR empty raises it right away */
+                if (!(p->ier & 0x02) && (value & 0x02) &&
+                                kfifo_is_empty(&p->tx))
+                        p->thre_pending = 1;
+                p->ier = value & 0x0f;
+                if (emu_irq_pending(p))
+                        emu_start(p);
+                break;
+        case FCR:
+                if (value & 0x02)
+                        kfifo_reset(&p->rx);
+                if (value & 0x04)
+                        kfifo_reset(&p->tx);
+                p->fcr = value & 0xc1;
+                break;
+        case LCR:
+                p->lcr = value;
+                break;
+        case MCR:
+                /* Delta CTS and delta DSR, through the loopback wiring */
+                if ((p->mcr ^ value) & 0x02)
+                        p->msr_deltas |= 0x01;
+                if ((p->mcr ^ value) & 0x01)
+                        p->msr_deltas |= 0x02;
+                p->mcr = value & 0x1f;
+                if (emu_irq_pending(p))
+                        emu_start(p);
+                break;
+        case SCR:
+                p->scr = value;
+                break;
+        }
+        spin_unlock_irqrestore(&p->lock, flags);
+}
+
+static void emu_write_burst(uint32_t addr, const uint8_t *buf, int count)
+{
+        while (count--)
+                emu_write(*buf++, addr);
+}
+
+static void emu_read_burst(uint32_t addr, uint8_t *buf, int count)
+{
+        while (count--)
+                *buf++ = emu_read(addr);
+}
+
+#define WRITE_TO_REG(port, reg, value)  emu_write(value, port + reg)
+#define READ_FROM_REG(port, reg)        emu_read(port + reg)
+#define WRITE_BURST_TO_REG(port, reg, buf, count)       \
+        emu_write_burst(port + reg, buf, count)
+#define READ_BURST_FROM_REG(port, reg, buf, count)      \
+        emu_read_burst(port + reg, buf, count)
+#define REQUEST_PORTS(port, irq, name)  emu_port_get(port, irq)
+#define RELEASE_PORTS(port)             emu_port_put(port)
+
+static inline int uart16550_hw_request_irq(int irq,
+                irq_handler_t handler, irq_handler_t thread,
+                const char *name, void *dev_id)
+{
+        struct emu_line *line = NULL;
+        int i;
+
+        spin_lock(&emu_ports_lock);
+        for (i = 0; !line && i < EMU_MAX_PORTS; i++) {
+                if (emu_lines[i].handler)
+                        continue;
+                line = &emu_lines[i];
+                spin_lock_init(&line->lock);
+                INIT_WORK(&line->thread_work, emu_thread_work);
+                line->irq = irq;
+                line->dev_id = dev_id;
+                line->thread = thread;
+                ACCESS_ONCE(line->handler) = handler;
+        }
+        spin_unlock(&emu_ports_lock);
+
+        return line ? 0 : -EBUSY;
+}
+
+static inline void uart16550_hw_free_irq(int irq, void *dev_id)
+{
+        struct emu_line *line = emu_line_find(irq);
+        unsigned long flags;
+
+        if (!line)
+                return;
+        /* Once unlocked, no tick is inside the handler any more */
+        spin_lock_irqsave(&line->lock, flags);
+        line->handler = NULL;
+        spin_unlock_irqrestore(&line->lock, flags);
+        cancel_work_sync(&line->thread_work);
+}
+
+#endif /* _UART16550_EMU */
@@ -8,6 +8,7 @@
 #include <linux/ioport.h>
 #include <linux/interrupt.h>
 #include <linux/types.h>
+#include <linux/time.h>
 
 #define UART16550_BAUD_1200     96
 #define UART16550_BAUD_2400     48
@@ -31,6 +32,14 @@
 #define UART16550_PAR_EVEN      0x18
 #define UART16550_PAR_STICK     0x20
 
+#define UART16550_DEFAULT_LINE  {               \
+                UART16550_BAUD_115200,          \
+                UART16550_LEN_8,                \
+                UART16550_PAR_NONE,             \
+                UART16550_STOP_1,               \
+                UART16550_FLOW_NONE             \
+        }
+
 /*
  * Extra helper macros.
  */
@@ -49,8 +58,57 @@
 #define MSR             0x06
 #define SCR             0x07
 
+#ifdef UART16550_EMULATED
+#include "uart16550_emu.h"
+#else
 #define WRITE_TO_REG(port, reg, value)  outb(value, port + reg)
 #define READ_FROM_REG(port, reg)        inb(port + reg)
+#define WRITE_BURST_TO_REG(port, reg, buf, count)       \
+        outsb(port + reg, buf, count)
+#define READ_BURST_FROM_REG(port, reg, buf, count)      \
+        insb(port + reg, buf, count)
+#define REQUEST_PORTS(port, irq, name)  request_region(port, NR_IO_PORTS, name)
+#define RELEASE_PORTS(port)             release_region(port, NR_IO_PORTS)
+
+/* Input clock of the baud rate generator, divided by DLL/DLM */
+#define UART16550_CLOCK         115200
+
+/* Bytes moved per THRE burst or RX drain, and the most it can ever be */
+#define UART16550_HW_FIFO_DEPTH UART16550_FIFO_DEPTH
+#define UART16550_FIFO_MAX      UART16550_FIFO_DEPTH
+
+static inline int uart16550_hw_request_irq(int irq,
+                irq_handler_t handler, irq_handler_t thread,
+                const char *name, void *dev_id)
+{
+        return request_threaded_irq(irq, handler, thread, IRQF_SHARED,
+                        name, dev_id);
+}
+
+static inline void uart16550_hw_free_irq(int irq, void *dev_id)
+{
+        free_irq(irq, dev_id);
+}
+#endif
+
+/* Depth of the hardware RX and TX FIFOs */
+#define UART16550_FIFO_DEPTH    16
+
+/* Default RX trigger level, bytes known to be in the FIFO when RDAI fires */
+#define UART16550_RX_TRIGGER    UART16550_TRIGGER_14
+
+/* IER bits */
+#define UART16550_IER_RDAI      0x01
+#define UART16550_IER_THREI     0x02
+#define UART16550_IER_MSI       0x08
+
+/* Interrupt identification, as returned by uart16550_hw_get_interrupt_id */
+#define UART16550_IID_NONE      -1
+#define UART16550_IID_MSI       0x00
+#define UART16550_IID_THREI     0x01
+#define UART16550_IID_RDAI      0x02
+#define UART16550_IID_RLSI      0x03
+#define UART16550_IID_TIMEOUT   0x06
 
 
 static inline void uart16550_hw_disable_interrupts(uint32_t port)
@@ -64,14 +122,51 @@ static inline void uart16550_hw_enable_interrupts(uint32_t port)
         WRITE_TO_REG(port, IER, 0x03);
 }
 
+static inline void uart16550_hw_set_interrupts(uint32_t port, int ier)
+{
+        WRITE_TO_REG(port, IER, ier);
+}
+
 static inline void uart16550_hw_force_interrupt_reemit(uint32_t port)
 {
         uart16550_hw_disable_interrupts(port);
         uart16550_hw_enable_interrupts(port);
 }
 
-static inline void uart16550_hw_set_line_parameters(uint32_t port,
+/* FCR value enabling the FIFOs with the given RX trigger level */
+static inline uint8_t uart16550_hw_fcr_trigger(int rx_trigger)
+{
+        switch (rx_trigger) {
+        case UART16550_TRIGGER_1:
+                return 0x01;
+        case UART16550_TRIGGER_4:
+                return 0x41;
+        case UART16550_TRIGGER_8:
+                return 0x81;
+        default:
+                return 0xc1;
+        }
+}
+
+/* Changes the trigger level without clearing the FIFOs */
+static inline void uart16550_hw_set_rx_trigger(uint32_t port, int rx_trigger)
+{
+        WRITE_TO_REG(port, FCR, uart16550_hw_fcr_trigger(rx_trigger));
+}
+
+/* Time it takes to shift one character at the given line parameters */
+static inline unsigned int uart16550_hw_char_time_ns(
                 struct uart16550_line_info parameters)
+{
+        /* Start bit, data bits, parity bit, stop bits */
+        unsigned int bits = 1 + 5 + (parameters.len & 0x03) +
+                (parameters.par ? 1 : 0) + (parameters.stop ? 2 : 1);
+
+        return bits * parameters.baud * (NSEC_PER_SEC / UART16550_CLOCK);
+}
+
+static inline void uart16550_hw_set_line_parameters(uint32_t port,
+                struct uart16550_line_info parameters, int rx_trigger)
 {
         WRITE_TO_REG(port, IER, 0x00); /* Disable the interrupt */
         /* DLAB set to high */
@@ -81,8 +176,8 @@ static inline void uart16550_hw_set_line_parameters(uint32_t port,
         /* DLAB set to low, length, stop and parity in place. */
         WRITE_TO_REG(port, LCR, parameters.len |
                         parameters.stop | parameters.par);
-        /* Use FIFO with 14 byte triggering. */
-        WRITE_TO_REG(port, FCR, 0xc7);
+        /* Clear and use the FIFOs with the requested triggering. */
+        WRITE_TO_REG(port, FCR, uart16550_hw_fcr_trigger(rx_trigger) | 0x06);
 
         /* Enable interrupt tri-state buffer. */
         WRITE_TO_REG(port, MCR, 0x08);
@@ -101,6 +196,22 @@ static inline int uart16550_hw_get_device_status(uint32_t port)
         return line_status;
 }
 
+/* Highest priority pending interrupt, or UART16550_IID_NONE */
+static inline int uart16550_hw_get_interrupt_id(uint32_t port)
+{
+        int isr_status = READ_FROM_REG(port, ISR);
+
+        if (isr_status & 0x01)
+                return UART16550_IID_NONE;
+
+        return (isr_status >> 1) & 0x07;
+}
+
+static inline int uart16550_hw_get_line_status(uint32_t port)
+{
+        return READ_FROM_REG(port, LSR);
+}
+
 static inline int uart16550_hw_device_can_send(int device_status)
 {
         return device_status & 0x20;
@@ -111,6 +222,31 @@ static inline int uart16550_hw_device_has_data(int device_status)
         return device_status & 0x01;
 }
 
+/* Drives RTS, asking the other end to (re)start or stop sending */
+static inline void uart16550_hw_set_rts(uint32_t port, int on)
+{
+        uint8_t mcr = READ_FROM_REG(port, MCR);
+
+        WRITE_TO_REG(port, MCR, on ? (mcr | 0x02) : (mcr & ~0x02));
+}
+
+/* Reading MSR also clears a pending modem status interrupt */
+static inline int uart16550_hw_get_modem_status(uint32_t port)
+{
+        return READ_FROM_REG(port, MSR);
+}
+
+static inline int uart16550_hw_clear_to_send(int modem_status)
+{
+        return modem_status & 0x10;
+}
+
+/* A character was lost to a full RX FIFO, reading LSR clears it */
+static inline int uart16550_hw_device_overrun(int device_status)
+{
+        return device_status & 0x02;
+}
+
 static inline void uart16550_hw_write_to_device(uint32_t port, uint8_t byte)
 {
         WRITE_TO_REG(port, THR, byte);
@@ -121,18 +257,32 @@ static uint8_t uart16550_hw_read_from_device(uint32_t port)
         return READ_FROM_REG(port, RBR);
 }
 
-static inline int uart16550_hw_setup_device(uint32_t port, char *module_name)
+/*
+ * Burst transfers, without checking LSR in between. Only valid when the
+ * FIFO is known to hold (or have room for) count bytes: the trigger level
+ * after RDAI, UART16550_FIFO_DEPTH once THRE is set.
+ */
+static inline void uart16550_hw_write_burst(uint32_t port,
+                const uint8_t *buf, int count)
+{
+        WRITE_BURST_TO_REG(port, THR, buf, count);
+}
+
+static inline void uart16550_hw_read_burst(uint32_t port,
+                uint8_t *buf, int count)
+{
+        READ_BURST_FROM_REG(port, RBR, buf, count);
+}
+
+/* The irq is only needed by the emulated backend, to route interrupts */
+static inline int uart16550_hw_setup_device(uint32_t port, int irq,
+                char *module_name)
 {
-        struct uart16550_line_info default_param = {
-                UART16550_BAUD_115200,
-                UART16550_LEN_8,
-                UART16550_STOP_1,
-                UART16550_PAR_NONE
-        };
+        struct uart16550_line_info default_param = UART16550_DEFAULT_LINE;
         /*
          * Request I/O port access.
          */
-        if (!request_region(port, NR_IO_PORTS, module_name))
+        if (!REQUEST_PORTS(port, irq, module_name))
                 return -ENODEV;
 
         if (READ_FROM_REG(port, LSR) & 0x01)
@@ -140,7 +290,8 @@ static inline int uart16550_hw_setup_device(uint32_t port, char *module_name)
         READ_FROM_REG(port, ISR);
         READ_FROM_REG(port, MSR);
         uart16550_hw_disable_interrupts(port);
-        uart16550_hw_set_line_parameters(port, default_param);
+        uart16550_hw_set_line_parameters(port, default_param,
+                        UART16550_RX_TRIGGER);
 
         return 0;
 }
@@ -150,7 +301,7 @@ static inline void uart16550_hw_cleanup_device(uint32_t port)
         /*
          * Release I/O port.
          */
-        release_region(port, NR_IO_PORTS);
+        RELEASE_PORTS(port);
         /*
          * Disable hardware interrupts.
          */
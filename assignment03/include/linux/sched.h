@@ -1169,6 +1169,12 @@ struct sched_rt_entity {
 
 struct sched_dummy_entity {
 	struct list_head run_list;
+	/* Queue of dummy_rq the entity is on, whatever prio says meanwhile */
+	unsigned int level;
+	/* Runtime in the current timeslice, in ns */
+	u64 timeslice;
+	/* dummy_rq tick count when it entered its queue, or was picked */
+	unsigned int age_stamp;
 };
 
 struct sched_dl_entity {
@@ -1838,6 +1838,7 @@ static void __sched_fork(unsigned long clone_flags, struct task_struct *p)
 	__dl_clear_params(p);
 
 	INIT_LIST_HEAD(&p->rt.run_list);
+	p->dummy_se.timeslice = 0;
 
 #ifdef CONFIG_PREEMPT_NOTIFIERS
 	INIT_HLIST_HEAD(&p->preempt_notifiers);
@@ -2713,7 +2714,15 @@ pick_next_task(struct rq *rq, struct task_struct *prev)
 		if (unlikely(p == RETRY_TASK))
 			goto again;
 
-		/* assumes fair_sched_class->next == idle_sched_class */
+		/*
+		 * assumes fair_sched_class->next == dummy_sched_class, which
+		 * may pull dummy tasks from other CPUs before going idle
+		 */
+		if (unlikely(!p)) {
+			p = dummy_sched_class.pick_next_task(rq, prev);
+			if (unlikely(p == RETRY_TASK))
+				goto again;
+		}
 		if (unlikely(!p))
 			p = idle_sched_class.pick_next_task(rq, prev);
 
@@ -5554,8 +5563,10 @@ static void free_rootdomain(struct rcu_head *rcu)
 {
 	struct root_domain *rd = container_of(rcu, struct root_domain, rcu);
 
+	cpupri_cleanup(&rd->dummypri);
 	cpupri_cleanup(&rd->cpupri);
 	cpudl_cleanup(&rd->cpudl);
+	free_cpumask_var(rd->dummyo_mask);
 	free_cpumask_var(rd->dlo_mask);
 	free_cpumask_var(rd->rto_mask);
 	free_cpumask_var(rd->online);
@@ -5612,15 +5623,23 @@ static int init_rootdomain(struct root_domain *rd)
 		goto free_online;
 	if (!alloc_cpumask_var(&rd->rto_mask, GFP_KERNEL))
 		goto free_dlo_mask;
+	if (!alloc_cpumask_var(&rd->dummyo_mask, GFP_KERNEL))
+		goto free_rto_mask;
 
 	init_dl_bw(&rd->dl_bw);
 	if (cpudl_init(&rd->cpudl) != 0)
-		goto free_dlo_mask;
+		goto free_dummyo_mask;
 
 	if (cpupri_init(&rd->cpupri) != 0)
-		goto free_rto_mask;
+		goto free_dummyo_mask;
+	if (cpupri_init(&rd->dummypri) != 0)
+		goto free_cpupri;
 	return 0;
 
+free_cpupri:
+	cpupri_cleanup(&rd->cpupri);
+free_dummyo_mask:
+	free_cpumask_var(rd->dummyo_mask);
 free_rto_mask:
 	free_cpumask_var(rd->rto_mask);
 free_dlo_mask:
@@ -6994,6 +7013,7 @@ void __init sched_init_smp(void)
 
 	init_sched_rt_class();
 	init_sched_dl_class();
+	init_sched_dummy_class();
 }
 #else
 void __init sched_init_smp(void)
@@ -67,9 +67,28 @@ static int convert_prio(int prio)
  */
 int cpupri_find(struct cpupri *cp, struct task_struct *p,
 		struct cpumask *lowest_mask)
+{
+	return cpupri_find_index(cp, convert_prio(p->prio), &p->cpus_allowed,
+				 lowest_mask);
+}
+
+/**
+ * cpupri_find_index - find the best (lowest-pri) CPU in the system
+ * @cp: The cpupri context
+ * @task_pri: The task's priority, already converted to a vector index
+ * @cpus_allowed: The CPUs the task may run on
+ * @lowest_mask: A mask to fill in with selected CPUs (or NULL)
+ *
+ * For users of a cpupri context with their own mapping of priorities to
+ * vector indexes, see cpupri_find().
+ *
+ * Return: (int)bool - CPUs were found
+ */
+int cpupri_find_index(struct cpupri *cp, int task_pri,
+		      const struct cpumask *cpus_allowed,
+		      struct cpumask *lowest_mask)
 {
 	int idx = 0;
-	int task_pri = convert_prio(p->prio);
 
 	BUG_ON(task_pri >= CPUPRI_NR_PRIORITIES);
 
@@ -103,11 +122,11 @@ int cpupri_find(struct cpupri *cp, struct task_struct *p,
 		if (skip)
 			continue;
 
-		if (cpumask_any_and(&p->cpus_allowed, vec->mask) >= nr_cpu_ids)
+		if (cpumask_any_and(cpus_allowed, vec->mask) >= nr_cpu_ids)
 			continue;
 
 		if (lowest_mask) {
-			cpumask_and(lowest_mask, &p->cpus_allowed, vec->mask);
+			cpumask_and(lowest_mask, cpus_allowed, vec->mask);
 
 			/*
 			 * We have to ensure that we have at least one bit
@@ -138,13 +157,29 @@ int cpupri_find(struct cpupri *cp, struct task_struct *p,
  * Returns: (void)
  */
 void cpupri_set(struct cpupri *cp, int cpu, int newpri)
+{
+	cpupri_set_index(cp, cpu, convert_prio(newpri));
+}
+
+/**
+ * cpupri_set_index - update the cpu priority setting
+ * @cp: The cpupri context
+ * @cpu: The target cpu
+ * @newpri: The vector index (CPUPRI_INVALID to CPUPRI_NR_PRIORITIES - 1)
+ *
+ * For users of a cpupri context with their own mapping of priorities to
+ * vector indexes, see cpupri_set().
+ *
+ * Note: Assumes cpu_rq(cpu)->lock is locked
+ *
+ * Returns: (void)
+ */
+void cpupri_set_index(struct cpupri *cp, int cpu, int newpri)
 {
 	int *currpri = &cp->cpu_to_pri[cpu];
 	int oldpri = *currpri;
 	int do_mb = 0;
 
-	newpri = convert_prio(newpri);
-
 	BUG_ON(newpri >= CPUPRI_NR_PRIORITIES);
 
 	if (newpri == oldpri)
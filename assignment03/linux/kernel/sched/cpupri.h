@@ -24,6 +24,10 @@ struct cpupri {
 int  cpupri_find(struct cpupri *cp,
 		 struct task_struct *p, struct cpumask *lowest_mask);
 void cpupri_set(struct cpupri *cp, int cpu, int pri);
+int  cpupri_find_index(struct cpupri *cp, int task_pri,
+		       const struct cpumask *cpus_allowed,
+		       struct cpumask *lowest_mask);
+void cpupri_set_index(struct cpupri *cp, int cpu, int newpri);
 int cpupri_init(struct cpupri *cp);
 void cpupri_cleanup(struct cpupri *cp);
 #else
@@ -6,13 +6,15 @@
 
 /*
  * Timeslice and age threshold are repsented in jiffies. Default timeslice
- * is 100ms. Both parameters can be tuned from /proc/sys/kernel.
+ * is 100ms. Both parameters can be tuned from /proc/sys/kernel. Runtime is
+ * accounted in ns against the timeslice, aging counts ticks.
  */
 
 #define DUMMY_TIMESLICE		(100 * HZ / 1000)
 #define DUMMY_AGE_THRESHOLD	(3 * DUMMY_TIMESLICE)
 
-#define KERNEL_DEBUG
+/* printk_deferred()s under rq->lock on every enqueue: off when measuring */
+/* #define KERNEL_DEBUG */
 
 unsigned int sysctl_sched_dummy_timeslice = DUMMY_TIMESLICE;
 static inline unsigned int get_timeslice(void)
@@ -20,6 +22,11 @@ static inline unsigned int get_timeslice(void)
 	return sysctl_sched_dummy_timeslice;
 }
 
+static inline u64 get_timeslice_ns(void)
+{
+	return (u64)get_timeslice() * TICK_NSEC;
+}
+
 unsigned int sysctl_sched_dummy_age_threshold = DUMMY_AGE_THRESHOLD;
 static inline unsigned int get_age_threshold(void)
 {
@@ -33,9 +40,25 @@ static inline unsigned int get_age_threshold(void)
 void init_dummy_rq(struct dummy_rq *dummy_rq, struct rq *rq)
 {
 	int i = 0;
+
+	/* sched_find_first_bit() scans 128 bits, delimiter included */
+	BUILD_BUG_ON(NR_OF_DUMMY_PRIORITIES > 127);
+
 	for (i = 0; i < NR_OF_DUMMY_PRIORITIES; i++) {
 		INIT_LIST_HEAD(&dummy_rq->queues[i]);
+		__clear_bit(i, dummy_rq->bitmap);
 	}
+	/* delimiter for bitsearch: */
+	__set_bit(NR_OF_DUMMY_PRIORITIES, dummy_rq->bitmap);
+
+	dummy_rq->dummy_nr_running = 0;
+#ifdef CONFIG_SMP
+	dummy_rq->highest_prio = MAX_PRIO;
+	dummy_rq->other_busy = 0;
+	dummy_rq->pri_idx = CPUPRI_IDLE;
+	dummy_rq->dummy_nr_migratory = 0;
+	dummy_rq->overloaded = 0;
+#endif
 }
 
 /*
@@ -47,30 +70,486 @@ static inline struct task_struct *dummy_task_of(struct sched_dummy_entity *dummy
 	return container_of(dummy_se, struct task_struct, dummy_se);
 }
 
+/*
+ * Charges the running task with the time since it was last accounted, in
+ * its sum_exec_runtime (so in /proc/<pid>/sched, cpuacct and getrusage)
+ * and in its timeslice.
+ */
+static void update_curr_dummy(struct rq *rq)
+{
+	struct task_struct *curr = rq->curr;
+	u64 delta_exec;
+
+	if (curr->sched_class != &dummy_sched_class)
+		return;
+
+	delta_exec = rq_clock_task(rq) - curr->se.exec_start;
+	if (unlikely((s64)delta_exec <= 0))
+		return;
+
+	schedstat_set(curr->se.statistics.exec_max,
+		      max(curr->se.statistics.exec_max, delta_exec));
+
+	curr->se.sum_exec_runtime += delta_exec;
+	account_group_exec_runtime(curr, delta_exec);
+
+	curr->se.exec_start = rq_clock_task(rq);
+	cpuacct_charge(curr, delta_exec);
+
+	curr->dummy_se.timeslice += delta_exec;
+}
+
+#ifdef CONFIG_SCHED_HRTICK
+/* Ends the timeslice on time rather than on the tick after */
+static void start_hrtick_dummy(struct rq *rq, struct task_struct *p)
+{
+	u64 slice = get_timeslice_ns();
+
+	if (p->dummy_se.timeslice < slice)
+		hrtick_start(rq, slice - p->dummy_se.timeslice);
+}
+#endif
+
 static inline void _enqueue_task_dummy(struct rq *rq, struct task_struct *p)
 {
 	struct dummy_rq *dummy_rq = &rq->dummy;
 	
-	/* Set timeslice & age_tick_count to 0 in the scheduling entity */
+	/* The age counts from now, the timeslice survives a sleep */
 	struct sched_dummy_entity *dummy_se = &p->dummy_se;
-	dummy_se->timeslice = 0;
-	dummy_se->age_tick_count = 0;
+	dummy_se->age_stamp = dummy_rq->dummy_age_tick_count;
 	
 	/* Put task into the right queue according to the dynamic prio */
-	struct list_head *queue = &dummy_rq->queues[p->prio - MIN_DUMMY_PRIO];
+	dummy_se->level = p->prio - MIN_DUMMY_PRIO;
+	struct list_head *queue = &dummy_rq->queues[dummy_se->level];
 	
 	list_add_tail(&dummy_se->run_list, queue);
+	__set_bit(dummy_se->level, dummy_rq->bitmap);
 	
 	unsigned int flags = 0;
 	check_preempt_curr_dummy(rq, p, flags);
 }
 
-static inline void _dequeue_task_dummy(struct task_struct *p)
+static inline void _dequeue_task_dummy(struct rq *rq, struct task_struct *p)
 {
+	struct dummy_rq *dummy_rq = &rq->dummy;
 	struct sched_dummy_entity *dummy_se = &p->dummy_se;
+
+	/* p->prio may have changed since, the entity knows its queue */
 	list_del_init(&dummy_se->run_list);
+	if (list_empty(&dummy_rq->queues[dummy_se->level]))
+		__clear_bit(dummy_se->level, dummy_rq->bitmap);
+}
+
+#ifdef CONFIG_SMP
+/*
+ * SMP balancing, after rt.c: a runqueue with more than one dummy task is
+ * overloaded and pushes its waiting tasks to CPUs running lower priority
+ * ones (or none), and a CPU about to go idle pulls the best waiting task
+ * of the busiest overloaded runqueue.
+ *
+ * rd->dummypri ranks the CPUs by their highest queued dummy task, with
+ * its own vector indexes: CPUPRI_IDLE for none, then 1 for the lowest
+ * level up to NR_OF_DUMMY_PRIORITIES for the highest. A CPU with tasks of
+ * a higher class queued ranks above them all, DUMMYPRI_BUSY, as no dummy
+ * task runs there before those are done; it is left to their balancing.
+ */
+
+#define DUMMY_MAX_TRIES 3
+#define DUMMYPRI_BUSY (NR_OF_DUMMY_PRIORITIES + 1)
+
+/* About to go idle: pull a waiting task from a busy CPU */
+static inline bool need_pull_dummy_task(struct rq *rq)
+{
+	return !rq->dummy.dummy_nr_running;
+}
+
+static inline int dummypri_of(int prio)
+{
+	if (prio >= MAX_PRIO)
+		return CPUPRI_IDLE;
+	return MAX_DUMMY_PRIO - prio + 1;
+}
+
+/* Also called by add/sub_nr_running(), for the other classes' tasks */
+void update_dummy_prio(struct rq *rq)
+{
+	struct dummy_rq *dummy_rq = &rq->dummy;
+	int idx = sched_find_first_bit(dummy_rq->bitmap);
+	int prio = MAX_PRIO;
+
+	if (idx < NR_OF_DUMMY_PRIORITIES)
+		prio = idx + MIN_DUMMY_PRIO;
+	dummy_rq->highest_prio = prio;
+	dummy_rq->other_busy = rq->nr_running > dummy_rq->dummy_nr_running;
+
+	idx = dummy_rq->other_busy ? DUMMYPRI_BUSY : dummypri_of(prio);
+	if (idx == dummy_rq->pri_idx)
+		return;
+
+	dummy_rq->pri_idx = idx;
+	if (rq->online)
+		cpupri_set_index(&rq->rd->dummypri, rq->cpu, idx);
+}
+
+static inline int dummy_overloaded(struct rq *rq)
+{
+	return atomic_read(&rq->rd->dummyo_count);
+}
+
+static inline void dummy_set_overload(struct rq *rq)
+{
+	if (!rq->online)
+		return;
+
+	cpumask_set_cpu(rq->cpu, rq->rd->dummyo_mask);
+	/*
+	 * The mask must be visible before the count, which is what
+	 * pull_dummy_task() checks first. Matched by its smp_rmb().
+	 */
+	smp_wmb();
+	atomic_inc(&rq->rd->dummyo_count);
+}
+
+static inline void dummy_clear_overload(struct rq *rq)
+{
+	if (!rq->online)
+		return;
+
+	atomic_dec(&rq->rd->dummyo_count);
+	cpumask_clear_cpu(rq->cpu, rq->rd->dummyo_mask);
+}
+
+static void update_dummy_migration(struct rq *rq)
+{
+	struct dummy_rq *dummy_rq = &rq->dummy;
+
+	if (dummy_rq->dummy_nr_migratory && dummy_rq->dummy_nr_running > 1) {
+		if (!dummy_rq->overloaded) {
+			dummy_set_overload(rq);
+			dummy_rq->overloaded = 1;
+		}
+	} else if (dummy_rq->overloaded) {
+		dummy_clear_overload(rq);
+		dummy_rq->overloaded = 0;
+	}
+}
+
+static void inc_dummy_tasks(struct rq *rq, struct task_struct *p)
+{
+	rq->dummy.dummy_nr_running++;
+	if (p->nr_cpus_allowed > 1)
+		rq->dummy.dummy_nr_migratory++;
+
+	update_dummy_migration(rq);
+}
+
+static void dec_dummy_tasks(struct rq *rq, struct task_struct *p)
+{
+	rq->dummy.dummy_nr_running--;
+	if (p->nr_cpus_allowed > 1)
+		rq->dummy.dummy_nr_migratory--;
+
+	update_dummy_migration(rq);
+}
+
+/* Waiting, and allowed to move to @cpu (anywhere else if -1) */
+static inline int pushable_dummy_task(struct rq *rq, struct task_struct *p,
+				      int cpu)
+{
+	if (task_running(rq, p) || p->nr_cpus_allowed < 2)
+		return 0;
+	return cpu == -1 || cpumask_test_cpu(cpu, tsk_cpus_allowed(p));
+}
+
+/* The first pushable task, from the highest level down */
+static struct task_struct *pick_highest_pushable_task(struct rq *rq, int cpu)
+{
+	struct dummy_rq *dummy_rq = &rq->dummy;
+	struct sched_dummy_entity *dummy_se;
+	struct task_struct *p;
+	int idx;
+
+	for_each_set_bit(idx, dummy_rq->bitmap, NR_OF_DUMMY_PRIORITIES) {
+		list_for_each_entry(dummy_se, &dummy_rq->queues[idx], run_list) {
+			p = dummy_task_of(dummy_se);
+			if (pushable_dummy_task(rq, p, cpu))
+				return p;
+		}
+	}
+
+	return NULL;
+}
+
+static DEFINE_PER_CPU(cpumask_var_t, dummy_local_cpu_mask);
+
+static int find_lowest_rq(struct task_struct *task)
+{
+	struct sched_domain *sd;
+	struct cpumask *lowest_mask = this_cpu_cpumask_var_ptr(dummy_local_cpu_mask);
+	int this_cpu = smp_processor_id();
+	int cpu      = task_cpu(task);
+
+	/* Make sure the mask is initialized first */
+	if (unlikely(!lowest_mask))
+		return -1;
+
+	if (task->nr_cpus_allowed == 1)
+		return -1; /* No other targets possible */
+
+	if (!cpupri_find_index(&task_rq(task)->rd->dummypri,
+			       dummypri_of(task->prio),
+			       tsk_cpus_allowed(task), lowest_mask))
+		return -1; /* No targets found */
+
+	/* The last cpu the task ran on is most likely cache-hot */
+	if (cpumask_test_cpu(cpu, lowest_mask))
+		return cpu;
+
+	/* Otherwise the closest one, by the sched_domains span maps */
+	if (!cpumask_test_cpu(this_cpu, lowest_mask))
+		this_cpu = -1; /* Skip this_cpu opt if not among lowest */
+
+	rcu_read_lock();
+	for_each_domain(cpu, sd) {
+		if (sd->flags & SD_WAKE_AFFINE) {
+			int best_cpu;
+
+			if (this_cpu != -1 &&
+			    cpumask_test_cpu(this_cpu, sched_domain_span(sd))) {
+				rcu_read_unlock();
+				return this_cpu;
+			}
+
+			best_cpu = cpumask_first_and(lowest_mask,
+						     sched_domain_span(sd));
+			if (best_cpu < nr_cpu_ids) {
+				rcu_read_unlock();
+				return best_cpu;
+			}
+		}
+	}
+	rcu_read_unlock();
+
+	if (this_cpu != -1)
+		return this_cpu;
+
+	cpu = cpumask_any(lowest_mask);
+	if (cpu < nr_cpu_ids)
+		return cpu;
+	return -1;
+}
+
+/* Will lock the rq it finds */
+static struct rq *find_lock_lowest_rq(struct task_struct *task, struct rq *rq)
+{
+	struct rq *lowest_rq = NULL;
+	int tries;
+	int cpu;
+
+	for (tries = 0; tries < DUMMY_MAX_TRIES; tries++) {
+		cpu = find_lowest_rq(task);
+
+		if ((cpu == -1) || (cpu == rq->cpu))
+			break;
+
+		lowest_rq = cpu_rq(cpu);
+
+		/* if the prio of this runqueue changed, try again */
+		if (double_lock_balance(rq, lowest_rq)) {
+			/*
+			 * rq->lock was dropped: the task may have moved, had
+			 * its affinity changed, or started running.
+			 */
+			if (unlikely(task_rq(task) != rq ||
+				     !cpumask_test_cpu(lowest_rq->cpu,
+						       tsk_cpus_allowed(task)) ||
+				     task_running(rq, task) ||
+				     !task_on_rq_queued(task))) {
+
+				double_unlock_balance(rq, lowest_rq);
+				lowest_rq = NULL;
+				break;
+			}
+		}
+
+		/* If this rq is still suitable use it. */
+		if (lowest_rq->dummy.highest_prio > task->prio &&
+		    !lowest_rq->dummy.other_busy)
+			break;
+
+		/* try again */
+		double_unlock_balance(rq, lowest_rq);
+		lowest_rq = NULL;
+	}
+
+	return lowest_rq;
+}
+
+/*
+ * If this CPU has more than one dummy task, see if a waiting one can move
+ * to a CPU running lower priority dummy tasks, or none.
+ */
+static int push_dummy_task(struct rq *rq)
+{
+	struct task_struct *next_task;
+	struct rq *lowest_rq;
+	int ret = 0;
+
+	if (!rq->dummy.overloaded)
+		return 0;
+
+	next_task = pick_highest_pushable_task(rq, -1);
+	if (!next_task)
+		return 0;
+
+retry:
+	/* It slipped in above current, just reschedule current */
+	if (unlikely(rq->curr->sched_class == &dummy_sched_class &&
+		     next_task->prio < rq->curr->prio)) {
+		resched_curr(rq);
+		return 0;
+	}
+
+	/* We might release rq lock */
+	get_task_struct(next_task);
+
+	/* find_lock_lowest_rq locks the rq if found */
+	lowest_rq = find_lock_lowest_rq(next_task, rq);
+	if (!lowest_rq) {
+		struct task_struct *task;
+		/*
+		 * rq->lock may have been dropped: only retry if next_task
+		 * is no longer the one to push.
+		 */
+		task = pick_highest_pushable_task(rq, -1);
+		if (task_cpu(next_task) == rq->cpu && task == next_task)
+			goto out;
+
+		if (!task)
+			goto out;
+
+		put_task_struct(next_task);
+		next_task = task;
+		goto retry;
+	}
+
+	deactivate_task(rq, next_task, 0);
+	set_task_cpu(next_task, lowest_rq->cpu);
+	activate_task(lowest_rq, next_task, 0);
+	ret = 1;
+
+	resched_curr(lowest_rq);
+
+	double_unlock_balance(rq, lowest_rq);
+
+out:
+	put_task_struct(next_task);
+
+	return ret;
+}
+
+static void push_dummy_tasks(struct rq *rq)
+{
+	/* push_dummy_task will return true if it moved a task */
+	while (push_dummy_task(rq))
+		;
+}
+
+/*
+ * Called with nothing left to run here: takes the best waiting task of
+ * the overloaded runqueue with the highest priority queued, the most
+ * loaded one among equals. The choice is made on unlocked reads, the
+ * source will push its tasks if it was wrong.
+ */
+static int pull_dummy_task(struct rq *this_rq)
+{
+	int this_cpu = this_rq->cpu, ret = 0, cpu, prio;
+	int best_prio = MAX_PRIO;
+	unsigned long nr, busiest_nr = 0;
+	struct rq *src_rq, *busiest = NULL;
+	struct task_struct *p;
+
+	if (likely(!dummy_overloaded(this_rq)))
+		return 0;
+
+	/*
+	 * Match the barrier from dummy_set_overload; this guarantees that if
+	 * we see overloaded we must also see the dummyo_mask bit.
+	 */
+	smp_rmb();
+
+	for_each_cpu(cpu, this_rq->rd->dummyo_mask) {
+		if (this_cpu == cpu)
+			continue;
+
+		src_rq = cpu_rq(cpu);
+		prio = ACCESS_ONCE(src_rq->dummy.highest_prio);
+		nr = ACCESS_ONCE(src_rq->dummy.dummy_nr_running);
+		if (prio < best_prio || (prio == best_prio && nr > busiest_nr)) {
+			best_prio = prio;
+			busiest_nr = nr;
+			busiest = src_rq;
+		}
+	}
+	if (!busiest)
+		return 0;
+
+	/* May drop this_rq's lock, another CPU could alter this_rq */
+	double_lock_balance(this_rq, busiest);
+
+	p = pick_highest_pushable_task(busiest, this_cpu);
+	if (p) {
+		WARN_ON(p == busiest->curr);
+		WARN_ON(!task_on_rq_queued(p));
+
+		deactivate_task(busiest, p, 0);
+		set_task_cpu(p, this_cpu);
+		activate_task(this_rq, p, 0);
+		ret = 1;
+	}
+
+	double_unlock_balance(this_rq, busiest);
+
+	return ret;
+}
+
+static inline void set_post_schedule(struct rq *rq)
+{
+	/* Push from post_schedule, without taking the rq lock again if idle */
+	rq->post_schedule = rq->dummy.overloaded;
+}
+
+#else
+
+static inline void update_dummy_prio(struct rq *rq)
+{
+}
+
+static inline void inc_dummy_tasks(struct rq *rq, struct task_struct *p)
+{
+	rq->dummy.dummy_nr_running++;
+}
+
+static inline void dec_dummy_tasks(struct rq *rq, struct task_struct *p)
+{
+	rq->dummy.dummy_nr_running--;
+}
+
+static inline bool need_pull_dummy_task(struct rq *rq)
+{
+	return false;
 }
 
+static inline int pull_dummy_task(struct rq *this_rq)
+{
+	return 0;
+}
+
+static inline void set_post_schedule(struct rq *rq)
+{
+}
+#endif /* CONFIG_SMP */
+
 /*
  * Scheduling class functions to implement
  */
@@ -78,13 +557,22 @@ static inline void _dequeue_task_dummy(struct task_struct *p)
 static void enqueue_task_dummy(struct rq *rq, struct task_struct *p, int flags)
 {
 	_enqueue_task_dummy(rq, p);
+	/*
+	 * Both counts are current before the CPU is republished, so that
+	 * add_nr_running() doesn't take the task for another class' one.
+	 */
+	inc_dummy_tasks(rq, p);
 	add_nr_running(rq,1);
+	update_dummy_prio(rq);
 }
 
 static void dequeue_task_dummy(struct rq *rq, struct task_struct *p, int flags)
 {
-	_dequeue_task_dummy(p);
+	update_curr_dummy(rq);
+	_dequeue_task_dummy(rq, p);
+	dec_dummy_tasks(rq, p);
 	sub_nr_running(rq,1);
+	update_dummy_prio(rq);
 }
 
 static void requeue_task_dummy(struct rq *rq, struct task_struct *p, int flags)
@@ -134,95 +622,140 @@ static struct task_struct *pick_next_task_dummy(struct rq *rq, struct task_struc
 	struct dummy_rq *dummy_rq = &(rq->dummy);
 	struct sched_dummy_entity *next;
 	struct task_struct *next_task;
-	
-	int i = 0;
-	/* Iterate over the different priorities until we find a task */
-	for (i = 0; i < NR_OF_DUMMY_PRIORITIES; i++) {
-		struct list_head *queue = &(dummy_rq->queues[i]);
-		
-		if (!list_empty(queue)) {
-			next = list_first_entry(queue, struct sched_dummy_entity, run_list);
-			next_task = dummy_task_of(next);
-			put_prev_task(rq, prev);
-			
-			if (next_task != dummy_rq->curr) {
-				/* Task will be executed, reset it's priority */
-				next_task->prio = next_task->normal_prio;
-
-				/* Reset time slice and age counters*/
-				next_task->dummy_se.timeslice = 0;
-				next_task->dummy_se.age_tick_count = 0;
-
-				dummy_rq->curr = next_task;
-			}
-			return next_task;
-		}
+	struct list_head *queue;
+	int idx;
+
+	if (need_pull_dummy_task(rq)) {
+		pull_dummy_task(rq);
+		/*
+		 * pull_dummy_task() can drop (and re-acquire) rq->lock; a
+		 * task of a higher class may have slipped in meanwhile.
+		 */
+		if (unlikely((rq->stop && task_on_rq_queued(rq->stop)) ||
+			     rq->dl.dl_nr_running || rq->rt.rt_queued ||
+			     rq->cfs.h_nr_running))
+			return RETRY_TASK;
 	}
-	/* if nothing is found */
-	return NULL;
-	
+
+	/* First non-empty queue, the delimiter if there is none */
+	idx = sched_find_first_bit(dummy_rq->bitmap);
+	if (idx >= NR_OF_DUMMY_PRIORITIES)
+		return NULL;
+
+	queue = &(dummy_rq->queues[idx]);
+	next = list_first_entry(queue, struct sched_dummy_entity, run_list);
+	next_task = dummy_task_of(next);
+	put_prev_task(rq, prev);
+
+	if (next_task != dummy_rq->curr) {
+		/* Task will be executed, reset it's priority */
+		next_task->prio = next_task->normal_prio;
+
+		/* Reset the age counter, the timeslice is only reset on expiry */
+		next_task->dummy_se.age_stamp = dummy_rq->dummy_age_tick_count;
+
+		dummy_rq->curr = next_task;
+	}
+	next_task->se.exec_start = rq_clock_task(rq);
+
+#ifdef CONFIG_SCHED_HRTICK
+	if (hrtick_enabled(rq))
+		start_hrtick_dummy(rq, next_task);
+#endif
+
+	set_post_schedule(rq);
+
+	return next_task;
 }
 
 static void put_prev_task_dummy(struct rq *rq, struct task_struct *prev)
 {
+	update_curr_dummy(rq);
 }
 
 static void set_curr_task_dummy(struct rq *rq)
 {
+	rq->curr->se.exec_start = rq_clock_task(rq);
+}
+
+/*
+ * Ages the tasks waiting at a level, in bulk: one that has waited
+ * get_age_threshold() ticks since its enqueue (or its last promotion) moves
+ * to the tail of the level above, with its age reset. Tasks are queued in
+ * the order they got their stamps, so only the expired ones at the front
+ * are looked at. The head is the exception: picking it resets its age.
+ */
+static void age_level_dummy(struct rq *rq, int level)
+{
+	struct dummy_rq *dummy_rq = &rq->dummy;
+	struct list_head *queue = &dummy_rq->queues[level];
+	struct list_head *upper = &dummy_rq->queues[level - 1];
+	unsigned int now = dummy_rq->dummy_age_tick_count;
+	struct sched_dummy_entity *dummy_se, *n;
+	struct task_struct *p;
+	int promoted = 0;
+
+	list_for_each_entry_safe(dummy_se, n, queue, run_list) {
+		if (now - dummy_se->age_stamp < get_age_threshold()) {
+			if (dummy_se->run_list.prev == queue)
+				continue;
+			break;
+		}
+
+		p = dummy_task_of(dummy_se);
+		p->prio = level - 1 + MIN_DUMMY_PRIO;
+		dummy_se->level = level - 1;
+		dummy_se->age_stamp = now;
+		list_move_tail(&dummy_se->run_list, upper);
+		promoted = 1;
+	}
+
+	if (!promoted)
+		return;
+	__set_bit(level - 1, dummy_rq->bitmap);
+	if (list_empty(queue))
+		__clear_bit(level, dummy_rq->bitmap);
+	if (level - 1 + MIN_DUMMY_PRIO < rq->curr->prio)
+		resched_curr(rq);
 }
 
+/*
+ * Costs O(levels), plus the tasks actually promoted: a task is looked at
+ * once per get_age_threshold() ticks at most, instead of on every tick.
+ */
 static void task_tick_dummy(struct rq *rq, struct task_struct *curr, int queued)
 {
 	struct dummy_rq *dummy_rq = &rq->dummy;
-	
 	int i;
-	/* Increment age & test for threshhold */
-	for (i = 1; i < NR_OF_DUMMY_PRIORITIES; i++) {
-		
-		#ifdef KERNEL_DEBUG
-		printk_deferred(KERN_ALERT "[info] iterating on priority %d\n", i);
-		#endif
-		
-		struct list_head *p, *n;
-		struct sched_dummy_entity *current_se;
-		
-		list_for_each_safe(p, n, &dummy_rq->queues[i]) {
-			current_se = list_entry(p, struct sched_dummy_entity, run_list);
-			current_se->age_tick_count++;
-			
-			/* Get corresponding task_struct */
-			struct task_struct *current_task = dummy_task_of(current_se);
-				
-			#ifdef KERNEL_DEBUG
-			printk_deferred(KERN_ALERT "[info] iterating on task_struct %u\n", current_task->pid);
-			printk_deferred(KERN_ALERT "[info] increment age, now at %u\n", current_se->age_tick_count);
-			#endif
-			
-			if (current_se->age_tick_count >= get_age_threshold()) {
-				
-				/* Set new priority and change queue */
-				unsigned int new_prio = i - 1 + MIN_DUMMY_PRIO;
-				current_se->prio_saved = current_task->prio;
-				current_task->prio = new_prio;
-				
-				current_se->age_tick_count = 0;
-				
-				/* Callback */
-				prio_changed_dummy(rq, current_task, new_prio + 1);
-			}
-		}
+
+	update_curr_dummy(rq);
+
+	/* An hrtick expiry (queued) only ends the timeslice, it is no tick */
+	if (!queued) {
+		/* The clock age stamps are taken from */
+		dummy_rq->dummy_age_tick_count++;
+
+		/* Highest level first: what gets promoted is not aged again */
+		for (i = 1; i < NR_OF_DUMMY_PRIORITIES; i++)
+			age_level_dummy(rq, i);
+		update_dummy_prio(rq);
 	}
-	
-	curr->dummy_se.timeslice++;
-	if (curr->dummy_se.timeslice >= get_timeslice()) {
+
+	if (curr->dummy_se.timeslice >= get_timeslice_ns()) {
 		unsigned int flags = 0;
-		if (curr->prio != curr->dummy_se.prio_saved) {
-			// Need to put it back to its old priority
-			curr->prio = curr->dummy_se.prio_saved;
-		}
+		/* Promoted while running: back to its own priority */
+		curr->prio = curr->normal_prio;
 		requeue_task_dummy(rq, curr, flags);
+		curr->dummy_se.timeslice = 0;
 		resched_curr(rq);
+		return;
 	}
+
+#ifdef CONFIG_SCHED_HRTICK
+	/* Fired a little early: wait for the rest of the timeslice */
+	if (hrtick_enabled(rq) && queued)
+		start_hrtick_dummy(rq, curr);
+#endif
 }
 
 static void switched_from_dummy(struct rq *rq, struct task_struct *p)
@@ -248,24 +781,126 @@ static unsigned int get_rr_interval_dummy(struct rq* rq, struct task_struct *p)
  * SMP related functions	
  */
 
-static inline int select_task_rq_dummy(struct task_struct *p, int cpu, int sd_flags, int wake_flags)
+/* An idle CPU sharing the last level cache with @cpu, @cpu itself first */
+static int select_idle_dummy(struct task_struct *p, int cpu)
 {
-	int new_cpu = smp_processor_id();
-	
-	return new_cpu; //set assigned CPU to zero
+	struct sched_domain *sd;
+	int i;
+
+	if (idle_cpu(cpu))
+		return cpu;
+
+	sd = rcu_dereference(per_cpu(sd_llc, cpu));
+	if (!sd)
+		return -1;
+
+	for_each_cpu_and(i, sched_domain_span(sd), tsk_cpus_allowed(p)) {
+		if (idle_cpu(i))
+			return i;
+	}
+	return -1;
 }
 
+/*
+ * Wake ups and forks go to an idle CPU in the LLC domain if there is one,
+ * else to the CPU running the lowest priority dummy tasks, if lower than
+ * the task's; the push/pull logic sorts out the rest.
+ */
+static int select_task_rq_dummy(struct task_struct *p, int cpu, int sd_flags, int wake_flags)
+{
+	int target;
+
+	if (p->nr_cpus_allowed == 1)
+		return cpu;
+
+	/* For anything but wake ups, just return the task_cpu */
+	if (sd_flags != SD_BALANCE_WAKE && sd_flags != SD_BALANCE_FORK)
+		return cpu;
+
+	rcu_read_lock();
+	target = select_idle_dummy(p, cpu);
+	if (target == -1)
+		target = find_lowest_rq(p);
+	rcu_read_unlock();
+
+	return target != -1 ? target : cpu;
+}
 
 static void set_cpus_allowed_dummy(struct task_struct *p,  const struct cpumask *new_mask)
 {
+	struct rq *rq;
+	int weight;
+
+	if (!task_on_rq_queued(p))
+		return;
+
+	weight = cpumask_weight(new_mask);
+
+	/* Only the change between migratable and not matters */
+	if ((p->nr_cpus_allowed > 1) == (weight > 1))
+		return;
+
+	rq = task_rq(p);
+	if (weight <= 1)
+		rq->dummy.dummy_nr_migratory--;
+	else
+		rq->dummy.dummy_nr_migratory++;
+
+	update_dummy_migration(rq);
+}
+
+static void post_schedule_dummy(struct rq *rq)
+{
+	push_dummy_tasks(rq);
+}
+
+/* Push now if the woken task is left waiting behind the current one */
+static void task_woken_dummy(struct rq *rq, struct task_struct *p)
+{
+	if (!task_running(rq, p) &&
+	    !test_tsk_need_resched(rq->curr) &&
+	    rq->dummy.overloaded &&
+	    p->nr_cpus_allowed > 1 &&
+	    rq->curr != rq->idle &&
+	    (rq->curr->sched_class != &dummy_sched_class ||
+	     rq->curr->prio <= p->prio))
+		push_dummy_tasks(rq);
+}
+
+/* Assumes rq->lock is held */
+static void rq_online_dummy(struct rq *rq)
+{
+	if (rq->dummy.overloaded)
+		dummy_set_overload(rq);
+
+	cpupri_set_index(&rq->rd->dummypri, rq->cpu, rq->dummy.pri_idx);
+}
+
+/* Assumes rq->lock is held */
+static void rq_offline_dummy(struct rq *rq)
+{
+	if (rq->dummy.overloaded)
+		dummy_clear_overload(rq);
+
+	cpupri_set_index(&rq->rd->dummypri, rq->cpu, CPUPRI_INVALID);
+}
+
+void __init init_sched_dummy_class(void)
+{
+	unsigned int i;
+
+	/* cpupri_set_index() BUG()s on indexes past its vector */
+	BUILD_BUG_ON(DUMMYPRI_BUSY >= CPUPRI_NR_PRIORITIES);
+
+	for_each_possible_cpu(i) {
+		zalloc_cpumask_var_node(&per_cpu(dummy_local_cpu_mask, i),
+					GFP_KERNEL, cpu_to_node(i));
+	}
 }
 #endif
 /*
  * Scheduling class
  */
-static void update_curr_dummy(struct rq*rq)
-{
-}
 const struct sched_class dummy_sched_class = {
 	.next			= &idle_sched_class,
 	.enqueue_task		= enqueue_task_dummy,
@@ -280,6 +915,10 @@ const struct sched_class dummy_sched_class = {
 #ifdef CONFIG_SMP
 	.select_task_rq		= select_task_rq_dummy,
 	.set_cpus_allowed	= set_cpus_allowed_dummy,
+	.rq_online		= rq_online_dummy,
+	.rq_offline		= rq_offline_dummy,
+	.post_schedule		= post_schedule_dummy,
+	.task_woken		= task_woken_dummy,
 #endif
 
 	.set_curr_task		= set_curr_task_dummy,
@@ -20,7 +20,7 @@ struct cpuidle_state;
 #define TASK_ON_RQ_QUEUED	1
 #define TASK_ON_RQ_MIGRATING	2
 
-#define NR_OF_PRIORITIES	MAX_DUMMY_PRIO - MIN_DUMMY_PRIO + 1
+#define NR_OF_DUMMY_PRIORITIES	(MAX_DUMMY_PRIO - MIN_DUMMY_PRIO + 1)
 
 
 extern __read_mostly int scheduler_running;
@@ -471,9 +471,30 @@ struct dl_rq {
 #endif
 };
 
+/*
+ * One queue per dummy priority level, with a bit set in bitmap for each
+ * non-empty one, so that picking the next task costs the same however many
+ * levels there are. sched_find_first_bit() handles up to 128 bits, so up
+ * to 127 levels with the delimiter; on SMP rd->dummypri needs two more
+ * indexes than there are levels, which caps them at CPUPRI_NR_PRIORITIES - 2.
+ */
 struct dummy_rq {
-	struct list_head queues[NR_OF_PRIORITIES];
+	DECLARE_BITMAP(bitmap, NR_OF_DUMMY_PRIORITIES+1); /* include 1 bit for delimiter */
+	struct list_head queues[NR_OF_DUMMY_PRIORITIES];
+	/* Ticks of dummy tasks on this rq, the clock of age stamps */
 	unsigned int dummy_age_tick_count;
+	struct task_struct *curr;
+	unsigned long dummy_nr_running;
+#ifdef CONFIG_SMP
+	/* Prio of the highest queued task, MAX_PRIO when there is none */
+	int highest_prio;
+	/* Tasks of a higher class are queued too: dummy ones can't run */
+	int other_busy;
+	/* Index published in rd->dummypri */
+	int pri_idx;
+	unsigned long dummy_nr_migratory;
+	int overloaded;
+#endif
 };
 
 #ifdef CONFIG_SMP
@@ -511,6 +532,15 @@ struct root_domain {
 	 */
 	cpumask_var_t rto_mask;
 	struct cpupri cpupri;
+
+	/*
+	 * The "dummy overload" flag: it gets set if a CPU has more than one
+	 * runnable dummy task. dummypri ranks the CPUs by their highest
+	 * queued dummy task (see dummy.c for its indexes).
+	 */
+	cpumask_var_t dummyo_mask;
+	atomic_t dummyo_count;
+	struct cpupri dummypri;
 };
 
 extern struct root_domain def_root_domain;
@@ -1213,6 +1243,7 @@ extern void update_max_interval(void);
 
 extern void init_sched_dl_class(void);
 extern void init_sched_rt_class(void);
+extern void init_sched_dummy_class(void);
 extern void init_sched_fair_class(void);
 extern void init_sched_dl_class(void);
 
@@ -1232,11 +1263,28 @@ extern void update_idle_cpu_load(struct rq *this_rq);
 
 extern void init_task_runnable_average(struct task_struct *p);
 
+#ifdef CONFIG_SMP
+extern void update_dummy_prio(struct rq *rq);
+
+/* Republishes the CPU in rd->dummypri when other classes come or go */
+static inline void dummy_nr_running_changed(struct rq *rq)
+{
+	if ((rq->nr_running > rq->dummy.dummy_nr_running) !=
+	    rq->dummy.other_busy)
+		update_dummy_prio(rq);
+}
+#else
+static inline void dummy_nr_running_changed(struct rq *rq)
+{
+}
+#endif
+
 static inline void add_nr_running(struct rq *rq, unsigned count)
 {
 	unsigned prev_nr = rq->nr_running;
 
 	rq->nr_running = prev_nr + count;
+	dummy_nr_running_changed(rq);
 
 	if (prev_nr < 2 && rq->nr_running >= 2) {
 #ifdef CONFIG_SMP
@@ -1263,6 +1311,7 @@ static inline void add_nr_running(struct rq *rq, unsigned count)
 static inline void sub_nr_running(struct rq *rq, unsigned count)
 {
 	rq->nr_running -= count;
+	dummy_nr_running_changed(rq);
 }
 
 static inline void rq_last_tick_reset(struct rq *rq)
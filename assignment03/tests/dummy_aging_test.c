@@ -0,0 +1,116 @@
+// Checks that aging promotes starved dummy tasks when it always did.
+//
+// A hog spins at the highest dummy priority (nice 11) on one CPU. For each
+// lower level L, a task at nice 11 + L is moved onto that CPU and times how
+// long it waits for it. The per-tick aging promoted a waiting task one
+// level every sched_dummy_age_threshold ticks, and the hog gave way at the
+// end of its timeslice once the task reached its level, so the wait must
+// lie between L * threshold and L * threshold + timeslice ticks.
+// Must be run as root (the tasks renice themselves).
+//
+// usage: ./dummy_aging_test [HZ] [cpu]
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define DUMMY_HIGHEST_NICE 11	// MIN_DUMMY_PRIO 131 - 120
+#define NR_LEVELS 5
+#define SLACK_TICKS 2		// tick boundaries, migration
+
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static long read_sysctl(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	long value = -1;
+
+	if (!f || fscanf(f, "%ld", &value) != 1)
+		perror(path);
+	if (f)
+		fclose(f);
+	return value;
+}
+
+static void pin(int cpu)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set))
+		perror("sched_setaffinity");
+}
+
+int main(int argc, char **argv)
+{
+	int hz = argc > 1 ? atoi(argv[1]) : 100;
+	int cpu = argc > 2 ? atoi(argv[2]) : 0;
+	long threshold = read_sysctl("/proc/sys/kernel/sched_dummy_age_threshold");
+	long timeslice = read_sysctl("/proc/sys/kernel/sched_dummy_timeslice");
+	double tick_ms = 1e3 / hz, waited, lo, hi;
+	int level, fds[2], failed = 0;
+	pid_t hog, waiter;
+
+	if (threshold < 0 || timeslice < 0)
+		return 1;
+
+	hog = fork();
+	if (hog == 0) {
+		setpriority(PRIO_PROCESS, 0, DUMMY_HIGHEST_NICE);
+		pin(cpu);
+		for (;;)
+			;
+	}
+	// Let the hog settle on its CPU
+	usleep(100000);
+
+	printf("%-6s %12s %12s %12s\n", "level", "waited ms", "min ms", "max ms");
+	for (level = 1; level < NR_LEVELS; level++) {
+		if (pipe(fds)) {
+			perror("pipe");
+			break;
+		}
+		waiter = fork();
+		if (waiter == 0) {
+			double start;
+
+			// Elsewhere until then, so it does not wait at nice 0
+			pin(cpu == 0 ? 1 : 0);
+			setpriority(PRIO_PROCESS, 0, DUMMY_HIGHEST_NICE + level);
+			start = now_ms();
+			pin(cpu);	// returns once it runs there
+			waited = now_ms() - start;
+			write(fds[1], &waited, sizeof(waited));
+			return 0;
+		}
+		if (read(fds[0], &waited, sizeof(waited)) != sizeof(waited))
+			waited = -1;
+		waitpid(waiter, NULL, 0);
+		close(fds[0]);
+		close(fds[1]);
+
+		lo = (level * threshold - SLACK_TICKS) * tick_ms;
+		hi = (level * threshold + timeslice + SLACK_TICKS) * tick_ms;
+		printf("%-6d %12.1f %12.1f %12.1f %s\n", level, waited, lo, hi,
+				waited >= lo && waited <= hi ? "ok" : "FAIL");
+		if (waited < lo || waited > hi)
+			failed = 1;
+	}
+
+	kill(hog, SIGKILL);
+	waitpid(hog, NULL, 0);
+	printf(failed ? "FAIL\n" : "PASS\n");
+	return failed;
+}
@@ -0,0 +1,90 @@
+// Context switch rate of the dummy scheduling class.
+//
+// Two processes pinned to one CPU bounce a byte over a pair of pipes, so
+// every round trip is two schedules through pick_next_task_dummy. Both run
+// at the lowest dummy priority (nice 15), the worst case for a pick that
+// scans the queues from the highest level down. Reports the switches per
+// second and the cost of one switch.
+//
+// usage: ./dummy_ctxsw_bench [round_trips] [cpu] [nice]
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define DUMMY_LOWEST_NICE 15	// MAX_DUMMY_PRIO 135 - 120
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void enter_dummy(int cpu, int nice)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set))
+		perror("sched_setaffinity");
+	if (setpriority(PRIO_PROCESS, 0, nice))
+		perror("setpriority");
+}
+
+int main(int argc, char **argv)
+{
+	long round_trips = argc > 1 ? atol(argv[1]) : 200000;
+	int cpu = argc > 2 ? atoi(argv[2]) : 0;
+	int nice = argc > 3 ? atoi(argv[3]) : DUMMY_LOWEST_NICE;
+	int ping[2], pong[2];
+	char byte = 0;
+	double start, elapsed;
+	long i;
+	pid_t pid;
+
+	if (pipe(ping) || pipe(pong)) {
+		perror("pipe");
+		return 1;
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return 1;
+	}
+	enter_dummy(cpu, nice);
+
+	if (pid == 0) {
+		// Echo every byte back
+		for (i = 0; i < round_trips; i++) {
+			if (read(ping[0], &byte, 1) != 1 ||
+					write(pong[1], &byte, 1) != 1)
+				break;
+		}
+		return 0;
+	}
+
+	start = now();
+	for (i = 0; i < round_trips; i++) {
+		if (write(ping[1], &byte, 1) != 1 ||
+				read(pong[0], &byte, 1) != 1) {
+			perror("round trip");
+			break;
+		}
+	}
+	elapsed = now() - start;
+	waitpid(pid, NULL, 0);
+
+	printf("nice %d on cpu %d: %ld round trips in %.3f s\n", nice, cpu, i,
+			elapsed);
+	printf("%.0f switches/s, %.0f ns per switch\n", 2 * i / elapsed,
+			elapsed * 1e9 / (2 * i));
+	return 0;
+}
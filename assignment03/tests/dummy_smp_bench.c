@@ -0,0 +1,139 @@
+// Throughput of CPU-bound dummy tasks, 4 per CPU, forked from one CPU.
+//
+// The parent forks every task while running on one CPU, so they all start
+// there: only wake-up placement, pushes and idle pulls spread them. Each
+// task counts loop iterations for a few seconds at nice 13 (a dummy
+// level). The same load is then run with every task pinned to one CPU;
+// the ratio of the two throughputs is the scaling across cores. Also
+// reports the CPUs the tasks ended up on.
+//
+// usage: ./dummy_smp_bench [seconds] [tasks_per_cpu] [nice]
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define DUMMY_MIDDLE_NICE 13	// prio 133, between MIN/MAX_DUMMY_PRIO
+
+struct slot {
+	volatile unsigned long long loops;
+	volatile int cpu;
+} __attribute__((aligned(64)));
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void pin(int cpu)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set))
+		perror("sched_setaffinity");
+}
+
+static void unpin(int nr_cpus)
+{
+	cpu_set_t set;
+	int i;
+
+	CPU_ZERO(&set);
+	for (i = 0; i < nr_cpus; i++)
+		CPU_SET(i, &set);
+	if (sched_setaffinity(0, sizeof(set), &set))
+		perror("sched_setaffinity");
+}
+
+// Returns the total loops per second of nr_tasks spinning for seconds
+static double run(struct slot *slots, int nr_tasks, int nr_cpus, int pinned,
+		double seconds, int nice, int *cpus_used)
+{
+	volatile int *go = (volatile int *)&slots[nr_tasks];
+	unsigned long long total = 0;
+	double start;
+	int i, j;
+	pid_t pid;
+
+	memset(slots, 0, sizeof(*slots) * nr_tasks);
+	*go = 1;
+
+	// Fork from CPU 0; the children may only leave it when not pinned
+	pin(0);
+	start = now();
+	for (i = 0; i < nr_tasks; i++) {
+		pid = fork();
+		if (pid < 0) {
+			perror("fork");
+			break;
+		}
+		if (pid == 0) {
+			// Dummy first, so that only its balancing spreads us
+			setpriority(PRIO_PROCESS, 0, nice);
+			if (!pinned)
+				unpin(nr_cpus);
+			while (*go)
+				slots[i].loops++;
+			slots[i].cpu = sched_getcpu();
+			_exit(0);
+		}
+	}
+	unpin(nr_cpus);
+
+	usleep(seconds * 1e6);
+	*go = 0;
+	while (wait(NULL) > 0)
+		;
+	seconds = now() - start;
+
+	*cpus_used = 0;
+	for (i = 0; i < nr_tasks; i++) {
+		total += slots[i].loops;
+		for (j = 0; j < i; j++)
+			if (slots[j].cpu == slots[i].cpu)
+				break;
+		if (j == i)
+			(*cpus_used)++;
+	}
+	return total / seconds;
+}
+
+int main(int argc, char **argv)
+{
+	double seconds = argc > 1 ? atof(argv[1]) : 5;
+	int per_cpu = argc > 2 ? atoi(argv[2]) : 4;
+	int nice = argc > 3 ? atoi(argv[3]) : DUMMY_MIDDLE_NICE;
+	int nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int nr_tasks = nr_cpus * per_cpu, used_one, used_all;
+	double one, all;
+	struct slot *slots;
+
+	slots = mmap(NULL, sizeof(*slots) * (nr_tasks + 1),
+			PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (slots == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+
+	printf("%d tasks at nice %d on %d CPUs, %.1f s per run\n", nr_tasks,
+			nice, nr_cpus, seconds);
+	one = run(slots, nr_tasks, nr_cpus, 1, seconds, nice, &used_one);
+	all = run(slots, nr_tasks, nr_cpus, 0, seconds, nice, &used_all);
+
+	printf("%-10s %16s %10s\n", "run", "loops/s", "cpus used");
+	printf("%-10s %16.0f %10d\n", "pinned", one, used_one);
+	printf("%-10s %16.0f %10d\n", "balanced", all, used_all);
+	printf("scaling %.2fx of %d CPUs\n", one ? all / one : 0.0, nr_cpus);
+	return 0;
+}